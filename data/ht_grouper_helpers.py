@@ -4,7 +4,8 @@ from qiskit.providers import Job
 from qiskit.quantum_info import Pauli
 from qiskit.result import Result
 import json
-from typing import Dict, List, Optional, Sequence, Union
+import subprocess
+from typing import Callable, Dict, List, Optional, Sequence, Union
 from qiskit import QuantumCircuit
 from qiskit.transpiler import PassManager
 from qiskit.transpiler.passes import InverseCancellation
@@ -45,6 +46,24 @@ def read_hamiltonian_from_json(filename: str) -> Dict[str, float]:
         return json.load(file)
 
 
+def write_scan(hamiltonian_filename: str, scan_filename: str, points: Dict[str, Dict[str, float]]):
+    """
+    Write the points of a scan (f.e. over bond lengths) for the grouper's 
+    `scan` option. `points` maps a label to a hamiltonian, all hamiltonians 
+    need to have the same Pauli strings. The term list is written to 
+    `hamiltonian_filename` and one line `<label> <coefficients>` per point 
+    to `scan_filename`. Labels are used in the output filenames and 
+    must not contain whitespace, path separators or "..". 
+    """
+    terms = list(next(iter(points.values())).keys())
+    with open(scan_filename, "w") as file:
+        for label, hamiltonian in points.items():
+            if hamiltonian.keys() != set(terms):
+                raise ValueError(f"The hamiltonian of point {label} has other Pauli strings than the first point")
+            file.write(" ".join([str(label)] + [repr(float(hamiltonian[term])) for term in terms]) + "\n")
+    write_hamiltonian_to_json(hamiltonian_filename, {term: 1.0 for term in terms})
+
+
 def read_grouping_from_json(filename: str) -> List[dict]:
     """
     Read a Pauli grouping from a JSON file of the following format:
@@ -71,6 +90,8 @@ def read_grouping_from_json(filename: str) -> List[dict]:
     applied to each qubit in the readout circuit. 
 
     Valid Clifford gates are "I", "H", "S", "SH", "HS" and "HSH". 
+    Groups of the baseline groupers with general commutation have 
+    `"cliffords": null`, they are not measurable with such circuits. 
 
     Pauli strings are read as 
        `"XYZ"` -> X on qubit 0, Y on qubit 1, Z on qubit 2
@@ -91,6 +112,150 @@ def read_grouping_from_json(filename: str) -> List[dict]:
         return result["grouping"]
 
 
+def read_grouping_from_json_lines(filename: str) -> List[dict]:
+    """
+    Read a Pauli grouping from a JSON Lines file written by the grouper
+    while it runs (`streamOutfilename`). Each line holds one group in the 
+    format described in :func:``read_grouping_from_json()`` together with 
+    its `"index"`, the last line contains a `"summary"`. 
+
+    Groups that were written again later replace the earlier line with the 
+    same index. If the file has no summary yet (the run is still going), 
+    the groups found so far are returned. 
+    """
+    groups = {}
+    num_groups = None
+    with open(filename) as file:
+        for line in file:
+            if not line.strip():
+                continue
+            record = json.loads(line)
+            if "summary" in record:
+                num_groups = record["summary"]["num groups"]
+            else:
+                groups[record.pop("index")] = record
+    if num_groups is None:
+        num_groups = len(groups)
+    return [groups[i] for i in range(num_groups) if i in groups]
+
+
+class GrouperDaemon:
+    """
+    Client for the long-lived grouping service (`grouper_daemon` executable). 
+    The daemon is started once and keeps its solver instances and sampled 
+    graphs between calls, so repeated groupings avoid the process start and 
+    the file round trip through `config.txt`. 
+
+    Example:
+    ```
+    with GrouperDaemon("../build/src/grouper/Release/grouper_daemon") as daemon:
+        grouping = daemon.group(ham, num_graphs=1000, seed=1)["grouping"]
+    ```
+
+    Pauli strings are read as 
+       `"XYZ"` -> X on qubit 0, Y on qubit 1, Z on qubit 2
+    """
+
+    def __init__(self, executable: str):
+        self.process = subprocess.Popen(
+            [executable], stdin=subprocess.PIPE, stdout=subprocess.PIPE, text=True, bufsize=1)
+        self.next_id = 0
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def request(self, method: str, params: Optional[dict] = None, on_group: Optional[Callable[[dict], None]] = None) -> dict:
+        """
+        Send a request and wait for its result. Groups that are sent while 
+        the grouper runs are passed to `on_group`. Raises a `RuntimeError` 
+        if the daemon answers with an error. 
+        """
+        self.next_id += 1
+        request = {"id": self.next_id, "method": method, "params": params or {}}
+        self.process.stdin.write(json.dumps(request) + "\n")
+        self.process.stdin.flush()
+        for line in self.process.stdout:
+            response = json.loads(line)
+            if response.get("id") != self.next_id:
+                continue
+            if "group" in response:
+                if on_group is not None:
+                    on_group(response["group"])
+            elif "error" in response:
+                raise RuntimeError(response["error"]["message"])
+            else:
+                return response["result"]
+        raise RuntimeError("The grouper daemon stopped unexpectedly")
+
+    def group(self, hamiltonian: Dict[str, float], connectivity: Union[str, List[List[int]]] = "linear",
+              num_graphs: int = 100, seed: int = 0, num_threads: int = 1, deadline: float = 0,
+              on_group: Optional[Callable[[dict], None]] = None, **params) -> dict:
+        """
+        Group a hamiltonian (dictionary of Pauli strings and coefficients) 
+        with the HT grouper. The connectivity is "linear", "cycle", "star" or
+        a list of edges. Further parameters (f.e. `maxEdgeCount`, 
+        `numMainPaulis`, `tailThreshold`) are passed on as they are. 
+
+        Returns the result with the `"grouping"` in the format described in 
+        :func:``read_grouping_from_json()`` and `"R_hat"`, `"runtime [seconds]"`
+        etc. 
+        """
+        params.update({"hamiltonian": hamiltonian, "connectivity": connectivity, "numGraphs": num_graphs,
+                       "seed": seed, "numThreads": num_threads, "deadline": deadline})
+        return self.request("group", params, on_group)
+
+    def close(self):
+        """Shut down the daemon. """
+        if self.process.poll() is None:
+            self.request("shutdown")
+            self.process.wait()
+
+
+def hamiltonian_to_arrays(hamiltonian: Dict[str, float]):
+    """
+    Convert a hamiltonian in form of a dictionary with Pauli strings as keys
+    into the arrays taken by the Python module `ht_grouper`: uint64 x-words,
+    uint64 z-words (bit j set for X/Y resp. Z/Y on qubit j) and float64 
+    coefficients, together with the number of qubits. 
+    """
+    paulis = list(hamiltonian.keys())
+    num_qubits = len(paulis[0]) if paulis else 0
+    x = np.zeros(len(paulis), dtype=np.uint64)
+    z = np.zeros(len(paulis), dtype=np.uint64)
+    for k, pauli in enumerate(paulis):
+        x[k] = sum(1 << j for j, p in enumerate(pauli) if p in "XY")
+        z[k] = sum(1 << j for j, p in enumerate(pauli) if p in "ZY")
+    coefficients = np.fromiter(hamiltonian.values(), dtype=np.float64, count=len(paulis))
+    return x, z, coefficients, num_qubits
+
+
+def group_with_module(hamiltonian: Dict[str, float], **kwargs) -> List[dict]:
+    """
+    Group a hamiltonian with the Python module `ht_grouper` (built with 
+    `-DPYTHON_BINDINGS=ON`) instead of the executable. Keyword arguments 
+    are passed to `ht_grouper.group()` (f.e. `connectivity`, `num_graphs`,
+    `seed`, `num_threads`). 
+
+    Returns the grouping in the format described in 
+    :func:``read_grouping_from_json()``. For repeated calls on the same 
+    terms, convert once with :func:``hamiltonian_to_arrays()`` and call 
+    `ht_grouper.group()` directly. 
+    """
+    import ht_grouper
+
+    paulis = list(hamiltonian.keys())
+    x, z, coefficients, num_qubits = hamiltonian_to_arrays(hamiltonian)
+    result = ht_grouper.group(x, z, coefficients, num_qubits, **kwargs)
+    grouping = [{"operators": [], "edges": edges.tolist(), "cliffords": [ht_grouper.clifford_names[c] for c in cliffords]}
+                for edges, cliffords in zip(result["edges"], result["cliffords"])]
+    for pauli, group in zip(paulis, result["groups"]):
+        grouping[group]["operators"].append(pauli)
+    return grouping
+
+
 def generate_readout_circuits(grouping: List[dict]) -> List[QuantumCircuit]:
     """
     Generate readout circuits from a Pauli grouping specified in the format
@@ -102,6 +267,8 @@ def generate_readout_circuits(grouping: List[dict]) -> List[QuantumCircuit]:
         num_qubits = len(group["operators"][0])
         edges = group["edges"]
         cliffords = group["cliffords"]
+        if cliffords is None:
+            raise ValueError("The grouping has no readout circuits (general commutation baseline)")
         circuit = QuantumCircuit(num_qubits)
         for qubit, clifford in enumerate(cliffords):
             for gate in clifford[::-1]:
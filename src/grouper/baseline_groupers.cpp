@@ -0,0 +1,161 @@
+
+#include "baseline_groupers.h"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+
+using namespace Q;
+
+
+namespace {
+
+	auto sortedPaulis(const Hamiltonian& hamiltonian) {
+		auto paulis = hamiltonian.operators;
+		// Sort by magnitude in descending order
+		std::ranges::sort(paulis, [](const auto& a, const auto& b) {return std::abs(a.second) > std::abs(b.second); });
+		std::vector<Pauli> result;
+		for (const auto& [pauli, _] : paulis) result.push_back(pauli);
+		return result;
+	}
+
+	bool commutes(const Pauli& p1, const Pauli& p2, Commutation commutation) {
+		return commutation == Commutation::QubitWise ? commutesQubitWise(p1, p2) : commutator(p1, p2) == 0;
+	}
+
+	CollectionWithGraph makeCollection(std::vector<Pauli> paulis, int numQubits, Commutation commutation) {
+		CollectionWithGraph collection{ std::move(paulis), Graph<>{ numQubits } };
+		if (commutation == Commutation::QubitWise) {
+			collection.singleQubitLayer = computeQubitWiseLayer(collection.paulis, numQubits);
+		}
+		return collection;
+	}
+
+
+	/// Adjacency matrix of the graph that connects each pair of non-commuting Paulis. Row i is a bit set
+	/// with bit j set if Paulis i and j do not commute.
+	class ConflictGraph {
+	public:
+		ConflictGraph(const std::vector<Pauli>& paulis, Commutation commutation, int numThreads)
+			: numWords((paulis.size() + 63) / 64), rows(paulis.size(), std::vector<uint64_t>(numWords)) {
+
+			// Each thread fills every numThreads-th row completely (both triangles), so no synchronization is needed
+			// and the work is balanced.
+			auto work = [&](size_t first) {
+				for (size_t i = first; i < paulis.size(); i += numThreads) {
+					for (size_t j = 0; j < paulis.size(); ++j) {
+						if (i != j && !commutes(paulis[i], paulis[j], commutation)) rows[i][j / 64] |= 1ULL << (j % 64);
+					}
+				}
+			};
+			std::vector<std::jthread> workers;
+			for (int t = 0; t < numThreads; ++t) workers.emplace_back(work, t);
+		}
+
+		size_t size() const { return rows.size(); }
+
+		int degree(size_t vertex) const {
+			return std::accumulate(rows[vertex].begin(), rows[vertex].end(), 0, [](int sum, uint64_t word) { return sum + std::popcount(word); });
+		}
+
+		template<class F>
+		void forEachNeighbour(size_t vertex, F&& f) const {
+			for (size_t w = 0; w < numWords; ++w) {
+				for (auto word = rows[vertex][w]; word != 0; word &= word - 1) {
+					f(w * 64 + std::countr_zero(word));
+				}
+			}
+		}
+
+	private:
+		size_t numWords;
+		std::vector<std::vector<uint64_t>> rows;
+	};
+
+
+	/// Smallest colour that is not marked as used.
+	int firstFreeColor(const std::vector<bool>& usedColors) {
+		return static_cast<int>(std::ranges::find(usedColors, false) - usedColors.begin());
+	}
+
+	std::vector<int> colorLargestFirst(const ConflictGraph& graph) {
+		std::vector<int> degrees(graph.size());
+		for (size_t v = 0; v < graph.size(); ++v) degrees[v] = graph.degree(v);
+
+		std::vector<size_t> order(graph.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::ranges::stable_sort(order, std::greater{}, [&](size_t v) { return degrees[v]; });
+
+		std::vector<int> colors(graph.size(), -1);
+		std::vector<bool> usedColors;
+		for (auto v : order) {
+			usedColors.assign(usedColors.size(), false);
+			graph.forEachNeighbour(v, [&](size_t w) { if (colors[w] >= 0) usedColors[colors[w]] = true; });
+			colors[v] = firstFreeColor(usedColors);
+			if (colors[v] == static_cast<int>(usedColors.size())) usedColors.push_back(false);
+		}
+		return colors;
+	}
+
+	std::vector<int> colorDSatur(const ConflictGraph& graph) {
+		std::vector<int> degrees(graph.size());
+		for (size_t v = 0; v < graph.size(); ++v) degrees[v] = graph.degree(v);
+
+		std::vector<int> colors(graph.size(), -1);
+		// Colours used by the neighbours of each vertex and their number (the saturation degree)
+		std::vector<std::vector<bool>> neighbourColors(graph.size());
+		std::vector<int> saturation(graph.size());
+
+		for (size_t step = 0; step < graph.size(); ++step) {
+			size_t next = graph.size();
+			for (size_t v = 0; v < graph.size(); ++v) {
+				if (colors[v] >= 0) continue;
+				if (next == graph.size() || std::pair{ saturation[v], degrees[v] } > std::pair{ saturation[next], degrees[next] }) next = v;
+			}
+
+			const int color = firstFreeColor(neighbourColors[next]);
+			colors[next] = color;
+			graph.forEachNeighbour(next, [&](size_t w) {
+				if (colors[w] >= 0) return;
+				auto& used = neighbourColors[w];
+				if (used.size() <= static_cast<size_t>(color)) used.resize(color + 1);
+				if (!used[color]) {
+					used[color] = true;
+					++saturation[w];
+				}
+			});
+		}
+		return colors;
+	}
+}
+
+
+
+std::vector<CollectionWithGraph> Q::applySortedInsertion(const Hamiltonian& hamiltonian, Commutation commutation) {
+	std::vector<std::vector<Pauli>> groups;
+	for (const auto& pauli : sortedPaulis(hamiltonian)) {
+		auto group = std::ranges::find_if(groups, [&](const auto& group) {
+			return std::ranges::all_of(group, [&](const auto& p) { return commutes(p, pauli, commutation); });
+		});
+		if (group == groups.end()) groups.push_back({ pauli });
+		else group->push_back(pauli);
+	}
+
+	std::vector<CollectionWithGraph> collections;
+	for (auto& group : groups) collections.push_back(makeCollection(std::move(group), hamiltonian.numQubits, commutation));
+	return collections;
+}
+
+
+std::vector<CollectionWithGraph> Q::applyGraphColoring(const Hamiltonian& hamiltonian, Commutation commutation, ColoringHeuristic heuristic, int numThreads) {
+	const auto paulis = sortedPaulis(hamiltonian);
+	const ConflictGraph graph{ paulis, commutation, numThreads };
+	const auto colors = heuristic == ColoringHeuristic::DSatur ? colorDSatur(graph) : colorLargestFirst(graph);
+
+	std::vector<std::vector<Pauli>> groups(paulis.empty() ? 0 : *std::ranges::max_element(colors) + 1);
+	for (size_t i = 0; i < paulis.size(); ++i) groups[colors[i]].push_back(paulis[i]);
+
+	std::vector<CollectionWithGraph> collections;
+	for (auto& group : groups) collections.push_back(makeCollection(std::move(group), hamiltonian.numQubits, commutation));
+	return collections;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "pauli_grouper.h"
+
+
+namespace Q {
+
+	/// @brief Commutation relation that Paulis in the same collection need to satisfy.
+	enum class Commutation {
+		General,   // Paulis commute (measurable with arbitrary Clifford circuits)
+		QubitWise  // Paulis commute qubit-wise (measurable with single-qubit gates)
+	};
+
+	/// @brief Heuristic for colouring the graph of non-commuting Paulis.
+	enum class ColoringHeuristic {
+		LargestFirst,  // Colour vertices in order of decreasing degree
+		DSatur         // Colour the vertex with the most differently coloured neighbours next
+	};
+
+
+	/// @brief Sorted insertion as in https://doi.org/10.22331/q-2021-01-20-385 (see also data/sorted_insertion.py).
+	///        Paulis are visited by decreasing magnitude of their coefficients and each one is put into the first
+	///        collection it commutes with.
+	///
+	///        The collections contain edgeless graphs. For Commutation::QubitWise, the single-qubit layer is set,
+	///        for Commutation::General it is left empty since the collections are generally not measurable with
+	///        single-qubit gates.
+	///
+	/// @param hamiltonian   Hamiltonian specification
+	/// @param commutation   Commutation relation within collections
+	/// @return Sets of commuting operators
+	std::vector<CollectionWithGraph> applySortedInsertion(const Hamiltonian& hamiltonian, Commutation commutation);
+
+
+	/// @brief Group Paulis by colouring the graph that connects each pair of Paulis that do not commute (with respect
+	///        to @p commutation). Each colour class forms a collection. Ties in the heuristics are broken in favour of
+	///        the Pauli with the larger coefficient magnitude.
+	///
+	///        The collections are formatted like for applySortedInsertion().
+	///
+	/// @param hamiltonian   Hamiltonian specification
+	/// @param commutation   Commutation relation within collections
+	/// @param heuristic     Colouring heuristic
+	/// @param numThreads    Number of threads used to build the graph of non-commuting Paulis
+	/// @return Sets of commuting operators
+	std::vector<CollectionWithGraph> applyGraphColoring(const Hamiltonian& hamiltonian, Commutation commutation, ColoringHeuristic heuristic, int numThreads = 1);
+
+}
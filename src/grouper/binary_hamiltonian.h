@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <span>
+#include "read_hamiltonians.h"
+
+namespace Q {
+
+
+	/// @brief Binary Hamiltonian file format. All values are stored in native byte order, the byte order mark
+	///        identifies it. Each array starts at a multiple of 8 bytes.
+	///
+	///            offset   size          content
+	///            0        8             magic "HTHAMBIN"
+	///            8        4             uint32 number of qubits
+	///            12       4             uint32 byte order mark 0x01020304
+	///            16       8             uint64 number of terms m
+	///            24       8 m           uint64 x-words (bit j set for X or Y on qubit j)
+	///            24+8m    8 m           uint64 z-words (bit j set for Z or Y on qubit j)
+	///            24+16m   8 m           double coefficients
+	///
+	///        Paulis are stored without phase. A phase of -1 is folded into the coefficient when writing, Paulis with 
+	///        phase ±i cannot be written (their coefficient would be imaginary).
+	namespace BinaryHamiltonianFormat {
+		inline constexpr char magic[8] = { 'H', 'T', 'H', 'A', 'M', 'B', 'I', 'N' };
+		inline constexpr uint32_t byteOrderMark = 0x01020304;
+		inline constexpr size_t headerSize = 24;
+	}
+
+
+	/// @brief Hamiltonian in struct-of-arrays layout that refers to the memory-mapped file directly (no copy).
+	class HamiltonianTable {
+	public:
+		explicit HamiltonianTable(const std::string& filename) : file(std::make_unique<MappedFile>(filename)) {
+			using namespace BinaryHamiltonianFormat;
+			const auto data = file->view();
+			if (data.size() < headerSize || !data.starts_with(std::string_view{ magic, sizeof(magic) }))
+				throw ReadHamiltonianError(std::format("{} is not a binary hamiltonian file", filename));
+
+			uint32_t qubits{};
+			uint32_t mark{};
+			uint64_t numTerms{};
+			std::memcpy(&qubits, data.data() + 8, sizeof(qubits));
+			std::memcpy(&mark, data.data() + 12, sizeof(mark));
+			std::memcpy(&numTerms, data.data() + 16, sizeof(numTerms));
+			if (mark != byteOrderMark) throw ReadHamiltonianError(std::format("The binary hamiltonian {} was written with a different byte order", filename));
+			if (qubits > 64) throw ReadHamiltonianError("Paulis with more than 64 qubits are currently not supported");
+			// Checked first so that 24 * numTerms cannot overflow
+			if (numTerms > (data.size() - headerSize) / 24)
+				throw ReadHamiltonianError(std::format("The binary hamiltonian {} has {} bytes, too few for {} terms", filename, data.size(), numTerms));
+			if (data.size() != headerSize + 24 * numTerms)
+				throw ReadHamiltonianError(std::format("The binary hamiltonian {} has {} bytes, expected {} for {} terms", filename, data.size(), headerSize + 24 * numTerms, numTerms));
+
+			numQubits = static_cast<int>(qubits);
+			const auto words = reinterpret_cast<const uint64_t*>(data.data() + headerSize);
+			xWords = { words, numTerms };
+			zWords = { words + numTerms, numTerms };
+			coefficients = { reinterpret_cast<const double*>(words + 2 * numTerms), numTerms };
+		}
+
+		size_t size() const { return coefficients.size(); }
+
+		Pauli pauli(size_t term) const { return Pauli::FromBitstrings(numQubits, xWords[term], zWords[term]); }
+
+		/// @brief Copy into the representation used by the grouper.
+		Hamiltonian toHamiltonian() const {
+			Hamiltonian hamiltonian{ {}, numQubits };
+			hamiltonian.operators.reserve(size());
+			for (size_t term = 0; term < size(); ++term) hamiltonian.operators.emplace_back(pauli(term), coefficients[term]);
+			return hamiltonian;
+		}
+
+		int numQubits{};
+		std::span<const uint64_t> xWords;
+		std::span<const uint64_t> zWords;
+		std::span<const double> coefficients;
+
+	private:
+		std::unique_ptr<MappedFile> file;
+	};
+
+
+	/// @brief Write a hamiltonian in the binary format (see BinaryHamiltonianFormat).
+	inline void writeHamiltonianBinary(const std::string& filename, const Hamiltonian& hamiltonian) {
+		using namespace BinaryHamiltonianFormat;
+		for (const auto& [pauli, _] : hamiltonian.operators) {
+			if (!pauli.getPhase().isPlusMinus()) throw std::runtime_error(std::format("Error, the Pauli {} has an imaginary phase and cannot be written", pauli));
+		}
+		std::ofstream file{ filename, std::ios::binary | std::ios::trunc };
+		if (!file) throw std::runtime_error(std::format("Error, could not open file {}", filename));
+
+		const auto numQubits = static_cast<uint32_t>(hamiltonian.numQubits);
+		const auto numTerms = static_cast<uint64_t>(hamiltonian.operators.size());
+		file.write(magic, sizeof(magic));
+		file.write(reinterpret_cast<const char*>(&numQubits), sizeof(numQubits));
+		file.write(reinterpret_cast<const char*>(&byteOrderMark), sizeof(byteOrderMark));
+		file.write(reinterpret_cast<const char*>(&numTerms), sizeof(numTerms));
+
+		std::vector<uint64_t> words;
+		words.reserve(hamiltonian.operators.size());
+		for (const auto& [pauli, _] : hamiltonian.operators) words.push_back(pauli.getXString());
+		file.write(reinterpret_cast<const char*>(words.data()), static_cast<std::streamsize>(words.size() * sizeof(uint64_t)));
+		words.clear();
+		for (const auto& [pauli, _] : hamiltonian.operators) words.push_back(pauli.getZString());
+		file.write(reinterpret_cast<const char*>(words.data()), static_cast<std::streamsize>(words.size() * sizeof(uint64_t)));
+		std::vector<double> coefficients;
+		coefficients.reserve(hamiltonian.operators.size());
+		for (const auto& [pauli, coefficient] : hamiltonian.operators) coefficients.push_back(pauli.getPhase() == BinaryPhase{ 2 } ? -coefficient : coefficient);
+		file.write(reinterpret_cast<const char*>(coefficients.data()), static_cast<std::streamsize>(coefficients.size() * sizeof(double)));
+
+		if (!file) throw std::runtime_error(std::format("Error, could not write file {}", filename));
+	}
+
+
+	/// @brief Check if given file starts with the magic of the binary hamiltonian format.
+	inline bool isBinaryHamiltonian(const std::string& filename) {
+		std::ifstream file{ filename, std::ios::binary };
+		char fileMagic[sizeof(BinaryHamiltonianFormat::magic)]{};
+		return file.read(fileMagic, sizeof(fileMagic)) && std::ranges::equal(fileMagic, BinaryHamiltonianFormat::magic);
+	}
+
+
+	/// @brief Read a hamiltonian in the binary format or as JSON (see readHamiltonianFromJson()).
+	inline Hamiltonian readHamiltonian(const std::string& filename) {
+		if (isBinaryHamiltonian(filename)) return HamiltonianTable{ filename }.toHamiltonian();
+		return readHamiltonianFromJson(filename);
+	}
+
+}
@@ -0,0 +1,252 @@
+
+#include "checkpoint.h"
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <format>
+#include <array>
+#include <bit>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+using namespace Q;
+
+
+namespace {
+
+	constexpr char magic[8] = { 'H', 'T', 'G', 'C', 'K', 'P', 'T', '2' };
+
+	class Writer {
+	public:
+		explicit Writer(std::ofstream& file) : file(file) {}
+
+		template<class T> requires std::is_trivially_copyable_v<T>
+		void write(const T& value) { file.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+		void writeSize(size_t size) { write(static_cast<uint64_t>(size)); }
+
+		template<class T>
+		void writeVector(const std::vector<T>& values) {
+			writeSize(values.size());
+			file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+		}
+
+	private:
+		std::ofstream& file;
+	};
+
+	class Reader {
+	public:
+		explicit Reader(std::ifstream& file) : file(file) {}
+
+		template<class T> requires std::is_trivially_copyable_v<T>
+		T read() {
+			T value{};
+			if (!file.read(reinterpret_cast<char*>(&value), sizeof(T))) throw CheckpointError("Unexpected end of checkpoint file");
+			return value;
+		}
+
+		size_t readSize() { return static_cast<size_t>(read<uint64_t>()); }
+
+		template<class T>
+		std::vector<T> readVector() {
+			std::vector<T> values(readSize());
+			if (!file.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T))))
+				throw CheckpointError("Unexpected end of checkpoint file");
+			return values;
+		}
+
+	private:
+		std::ifstream& file;
+	};
+
+	// Single-qubit gates as 4-bit codes (entries of the binary matrix in row-major order)
+	uint8_t encodeGate(const BinaryCliffordGate& gate) {
+		return static_cast<uint8_t>(gate(0, 0).toInt() | gate(0, 1).toInt() << 1 | gate(1, 0).toInt() << 2 | gate(1, 1).toInt() << 3);
+	}
+
+	BinaryCliffordGate decodeGate(uint8_t code) {
+		return BinaryCliffordGate{ Binary(code & 1), Binary((code >> 1) & 1), Binary((code >> 2) & 1), Binary((code >> 3) & 1) };
+	}
+
+	// Flush a closed file to disk so that it survives a crash right after the rename
+	void syncFile(const std::string& filename) {
+#ifdef _WIN32
+		const int fd = ::_open(filename.c_str(), _O_RDWR | _O_BINARY);
+		if (fd < 0) throw CheckpointError(std::format("Could not open file \"{}\"", filename));
+		const bool synced = ::_commit(fd) == 0;
+		::_close(fd);
+#else
+		const int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) throw CheckpointError(std::format("Could not open file \"{}\"", filename));
+		const bool synced = ::fsync(fd) == 0;
+		::close(fd);
+#endif
+		if (!synced) throw CheckpointError(std::format("Could not sync checkpoint \"{}\" to disk", filename));
+	}
+
+	size_t termIndex(const Hamiltonian& hamiltonian, const Pauli& pauli) {
+		const auto it = std::ranges::find(hamiltonian.operators, pauli, [](const auto& a) { return a.first; });
+		if (it == hamiltonian.operators.end()) throw CheckpointError(std::format("The Pauli {} is not part of the hamiltonian", pauli));
+		return static_cast<size_t>(it - hamiltonian.operators.begin());
+	}
+}
+
+
+std::string Q::checkpointFilename(const std::string& outfilename) {
+	return outfilename + ".checkpoint";
+}
+
+
+uint64_t Q::checkpointSetupHash(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, const GrouperOptions& options) {
+	// splitmix64 finalizer as in CollectionCache::fingerprint()
+	auto mix = [](uint64_t value) {
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+		return value ^ (value >> 31);
+	};
+	uint64_t hash = 0x9e3779b97f4a7c15;
+	auto add = [&](uint64_t value) { hash = mix(hash ^ mix(value)); };
+
+	add(static_cast<uint64_t>(hamiltonian.numQubits));
+	add(hamiltonian.operators.size());
+	for (const auto& [pauli, coefficient] : hamiltonian.operators) {
+		add(pauli.getXString());
+		add(pauli.getZString());
+		add(std::bit_cast<uint64_t>(coefficient));
+	}
+	add(graphs.size());
+	for (const auto& graph : graphs) {
+		const auto edges = graph.getEdges();
+		add(edges.size());
+		for (const auto& [i, j] : edges) add(static_cast<uint64_t>(i) << 32 | static_cast<uint64_t>(j));
+	}
+	add(static_cast<uint64_t>(options.collectionSolver));
+	add(std::bit_cast<uint64_t>(options.mipTimeLimit));
+	add(options.mipWeighted);
+	add(static_cast<uint64_t>(options.numMainPaulis));
+	add(static_cast<uint64_t>(options.graphsPerIteration));
+	add(std::bit_cast<uint64_t>(options.timeBudget));
+	add(std::bit_cast<uint64_t>(options.tailThreshold));
+	return hash;
+}
+
+
+GrouperCheckpoint Q::readCheckpoint(const std::string& filename, const Hamiltonian& hamiltonian) {
+	std::ifstream file{ filename, std::ios::binary };
+	if (!file) throw CheckpointError(std::format("Could not open file \"{}\"", filename));
+
+	char fileMagic[sizeof(magic)]{};
+	if (!file.read(fileMagic, sizeof(magic)) || !std::ranges::equal(fileMagic, magic)) throw CheckpointError(std::format("\"{}\" is not a checkpoint file", filename));
+
+	Reader reader{ file };
+	GrouperCheckpoint checkpoint;
+	checkpoint.seed = reader.read<uint64_t>();
+	checkpoint.numQubits = reader.read<int32_t>();
+	checkpoint.numTerms = reader.readSize();
+	checkpoint.numGraphs = reader.readSize();
+	checkpoint.setupHash = reader.read<uint64_t>();
+	if (checkpoint.numQubits != hamiltonian.numQubits || checkpoint.numTerms != hamiltonian.operators.size())
+		throw CheckpointError(std::format("The checkpoint is for a hamiltonian with {} terms on {} qubits", checkpoint.numTerms, checkpoint.numQubits));
+
+	auto pauliAt = [&](uint64_t index) {
+		if (index >= hamiltonian.operators.size()) throw CheckpointError("Invalid term index in checkpoint");
+		return hamiltonian.operators[index].first;
+	};
+
+	checkpoint.collections.resize(reader.readSize());
+	for (auto& collection : checkpoint.collections) {
+		for (auto index : reader.readVector<uint64_t>()) collection.paulis.push_back(pauliAt(index));
+		collection.graph = Graph<>{ checkpoint.numQubits };
+		for (auto [i, j] : reader.readVector<std::array<int32_t, 2>>()) collection.graph.addEdge(i, j);
+		for (auto code : reader.readVector<uint8_t>()) collection.singleQubitLayer.push_back(decodeGate(code));
+	}
+	for (auto index : reader.readVector<uint64_t>()) {
+		pauliAt(index);
+		checkpoint.remaining.push_back(static_cast<size_t>(index));
+	}
+
+	const auto state = reader.readVector<char>();
+	checkpoint.randomGeneratorState.assign(state.begin(), state.end());
+	checkpoint.graphStatistics.resize(reader.readSize());
+	for (auto& statistics : checkpoint.graphStatistics) {
+		statistics.evaluations = reader.readSize();
+		statistics.feasible = reader.readSize();
+		statistics.wins = reader.readSize();
+		statistics.totalReward = reader.read<double>();
+		statistics.totalSize = reader.read<double>();
+		statistics.totalSeconds = reader.read<double>();
+	}
+	checkpoint.numGraphEvaluations = reader.readSize();
+	checkpoint.numExhaustiveGraphEvaluations = reader.readSize();
+	checkpoint.numPrunedUnits = reader.readSize();
+	for (auto count : reader.readVector<uint64_t>()) checkpoint.graphsEvaluated.push_back(static_cast<size_t>(count));
+
+	checkpoint.elapsedSeconds = reader.read<double>();
+	checkpoint.secondsPerUnit = reader.read<double>();
+	checkpoint.lastCollectionSize = reader.readSize();
+	return checkpoint;
+}
+
+
+void Q::writeCheckpoint(const std::string& filename, const GrouperCheckpoint& checkpoint, const Hamiltonian& hamiltonian) {
+	const auto temporaryFilename = filename + ".tmp";
+	{
+		std::ofstream file{ temporaryFilename, std::ios::binary | std::ios::trunc };
+		if (!file) throw CheckpointError(std::format("Could not open file \"{}\"", temporaryFilename));
+		file.write(magic, sizeof(magic));
+
+		Writer writer{ file };
+		writer.write(static_cast<uint64_t>(checkpoint.seed));
+		writer.write(static_cast<int32_t>(checkpoint.numQubits));
+		writer.writeSize(checkpoint.numTerms);
+		writer.writeSize(checkpoint.numGraphs);
+		writer.write(checkpoint.setupHash);
+
+		writer.writeSize(checkpoint.collections.size());
+		for (const auto& collection : checkpoint.collections) {
+			std::vector<uint64_t> indices;
+			for (const auto& pauli : collection.paulis) indices.push_back(termIndex(hamiltonian, pauli));
+			writer.writeVector(indices);
+			std::vector<std::array<int32_t, 2>> edges;
+			for (const auto& [i, j] : collection.graph.getEdges()) edges.push_back({ i, j });
+			writer.writeVector(edges);
+			std::vector<uint8_t> layer;
+			for (const auto& gate : collection.singleQubitLayer) layer.push_back(encodeGate(gate));
+			writer.writeVector(layer);
+		}
+		writer.writeVector(std::vector<uint64_t>(checkpoint.remaining.begin(), checkpoint.remaining.end()));
+
+		writer.writeVector(std::vector<char>(checkpoint.randomGeneratorState.begin(), checkpoint.randomGeneratorState.end()));
+		writer.writeSize(checkpoint.graphStatistics.size());
+		for (const auto& statistics : checkpoint.graphStatistics) {
+			writer.writeSize(statistics.evaluations);
+			writer.writeSize(statistics.feasible);
+			writer.writeSize(statistics.wins);
+			writer.write(statistics.totalReward);
+			writer.write(statistics.totalSize);
+			writer.write(statistics.totalSeconds);
+		}
+		writer.writeSize(checkpoint.numGraphEvaluations);
+		writer.writeSize(checkpoint.numExhaustiveGraphEvaluations);
+		writer.writeSize(checkpoint.numPrunedUnits);
+		writer.writeVector(std::vector<uint64_t>(checkpoint.graphsEvaluated.begin(), checkpoint.graphsEvaluated.end()));
+
+		writer.write(checkpoint.elapsedSeconds);
+		writer.write(checkpoint.secondsPerUnit);
+		writer.writeSize(checkpoint.lastCollectionSize);
+
+		file.flush();
+		if (!file) throw CheckpointError(std::format("Could not write checkpoint to \"{}\"", temporaryFilename));
+	}
+	syncFile(temporaryFilename);
+	std::filesystem::rename(temporaryFilename, filename);
+}
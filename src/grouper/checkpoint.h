@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include "pauli_grouper.h"
+
+namespace Q {
+
+
+	class CheckpointError : public std::runtime_error {
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+
+	/// @brief Statistics of a graph for the adaptive graph selection of applyPauliGrouper2Multithread2().
+	struct GraphStatistics {
+		size_t evaluations{};
+		size_t feasible{};
+		size_t wins{};
+		double totalReward{};
+		double totalSize{};
+		double totalSeconds{};
+	};
+
+
+	/// @brief State of applyPauliGrouper2Multithread2() between two iterations. Continuing from it gives the same
+	///        grouping as the uninterrupted run (given the same hamiltonian, graphs and options). With a time budget,
+	///        only the remaining time is used.
+	///
+	///        Checkpoints are stored in a binary file (native byte order) starting with "HTGCKPT2", followed by the
+	///        members in the order of declaration. Paulis are stored as indices into the operators of the hamiltonian,
+	///        single-qubit gates as 4-bit codes.
+	struct GrouperCheckpoint {
+		// Seed of the run, used for sampling the graphs and for the adaptive graph selection
+		uint64_t seed{};
+		// Size of the problem, checked when resuming
+		int numQubits{};
+		size_t numTerms{};
+		size_t numGraphs{};
+		// Hash of the hamiltonian, the graph list and the options that change the grouping (see checkpointSetupHash())
+		uint64_t setupHash{};
+
+		// Accepted collections with their single-qubit layers
+		std::vector<CollectionWithGraph> collections;
+		// Remaining Paulis as indices into the operators of the hamiltonian, in the order of the grouper
+		std::vector<size_t> remaining;
+
+		// State of the random generator of the adaptive graph selection (as written by operator<<)
+		std::string randomGeneratorState;
+		std::vector<GraphStatistics> graphStatistics;
+		size_t numGraphEvaluations{};
+		size_t numExhaustiveGraphEvaluations{};
+		size_t numPrunedUnits{};
+		std::vector<size_t> graphsEvaluated;
+
+		// Time spent so far and estimates used for a time budget
+		double elapsedSeconds{};
+		double secondsPerUnit{};
+		size_t lastCollectionSize{ 1 };
+	};
+
+
+	/// @brief Hash of everything besides the seed that a resumed run needs to share with the interrupted one: terms 
+	///        and coefficients of the hamiltonian, the graphs in order and the options that change the grouping 
+	///        (collectionSolver, mipTimeLimit, mipWeighted, numMainPaulis, graphsPerIteration, timeBudget, tailThreshold). 
+	uint64_t checkpointSetupHash(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, const GrouperOptions& options);
+
+	/// @brief Default checkpoint file for given output file (next to it).
+	std::string checkpointFilename(const std::string& outfilename);
+
+	/// @brief Read a checkpoint written by writeCheckpoint() for the given hamiltonian.
+	GrouperCheckpoint readCheckpoint(const std::string& filename, const Hamiltonian& hamiltonian);
+
+	/// @brief Write a checkpoint atomically: the data is written to a temporary file next to @p filename, synced to
+	///        disk and then replaces it, so an interrupted write or a crash leaves the previous checkpoint intact.
+	void writeCheckpoint(const std::string& filename, const GrouperCheckpoint& checkpoint, const Hamiltonian& hamiltonian);
+
+}
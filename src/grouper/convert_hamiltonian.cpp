@@ -0,0 +1,38 @@
+
+#include "binary_hamiltonian.h"
+#include <filesystem>
+
+using namespace Q;
+
+
+// Convert hamiltonians to the binary format (see BinaryHamiltonianFormat). 
+//
+//   convert_hamiltonian <input> <output>
+//
+// Input files ending in .json are read with readHamiltonianFromJson(), others are read as one python dictionary per 
+// line with readHamiltonians(). If a file contains several hamiltonians, they are written to <output>_0, <output>_1, ...
+int main(int argc, char* argv[]) {
+	if (argc != 3) {
+		println("Usage: {} <input> <output>", argc > 0 ? argv[0] : "convert_hamiltonian");
+		return 1;
+	}
+	const std::string input = argv[1];
+	const std::string output = argv[2];
+
+	try {
+		std::vector<Hamiltonian> hamiltonians;
+		if (std::filesystem::path(input).extension() == ".json") hamiltonians.push_back(readHamiltonianFromJson(input));
+		else hamiltonians = readHamiltonians(input);
+
+		for (size_t i = 0; i < hamiltonians.size(); ++i) {
+			const auto filename = hamiltonians.size() == 1 ? output : std::format("{}_{}", output, i);
+			writeHamiltonianBinary(filename, hamiltonians[i]);
+			println("Wrote {} terms on {} qubits to {}", hamiltonians[i].operators.size(), hamiltonians[i].numQubits, filename);
+		}
+	}
+	catch (std::exception& e) {
+		println("{}", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,304 @@
+
+#include "pauli_grouper.h"
+#include "find_ht_circuit.h"
+#include "json_formatting.h"
+#include "estimated_shot_reduction.h"
+#include "subgraph_sampling.h"
+#include "json_parser.h"
+#include <chrono>
+#include <deque>
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <map>
+#include <random>
+#include <tuple>
+#include <variant>
+
+using namespace Q;
+
+
+// Long-lived grouping service. Requests and responses are JSON objects, one per line (JSON Lines), read from stdin
+// and written to stdout. Log output goes to stderr. Solver instances and sampled graph sets (the 64 most recent ones
+// with a fixed seed) are kept between requests.
+//
+//   grouper_daemon
+//
+// Requests: {"id": 1, "method": "group", "params": {...}}, the id is echoed in every response to the request.
+//
+//   group     Group a hamiltonian with the HT grouper. Parameters (all but "hamiltonian" are optional):
+//               "hamiltonian"    {"XXI": 0.5, "IZZ": -1.2, ...}
+//               "connectivity"   "linear" (default), "cycle", "star" or a list of edges [[0,1],[1,2],...]
+//               "numGraphs"      number of random subgraphs (default 100)
+//               "maxEdgeCount"   maximum number of edges of the subgraphs (default 1000)
+//               "seed"           seed for sampling the subgraphs (default 0: random)
+//               "numThreads"     (default 1)
+//               "numMainPaulis"  (default 1)
+//               "deadline"       wall-clock budget in seconds, see GrouperOptions::timeBudget (default 0: none)
+//               "tailThreshold"  see GrouperOptions::tailThreshold (default 0)
+//               "verbose"        log the progress to stderr (default false)
+//             Each group is sent as soon as it is accepted: {"id": 1, "group": {"index": 0, "operators": [...], ...}}
+//             followed by the result {"id": 1, "result": {"num groups": 12, ..., "grouping": [...]}}. The final
+//             grouping may differ from the groups sent before (tail insertion).
+//   status    Number of requests served, solver instances and cached graph sets.
+//   shutdown  Answer with an empty result and exit.
+//
+// Failing requests are answered with {"id": 1, "error": {"message": "..."}}.
+
+
+namespace {
+
+	class RequestError : public std::runtime_error {
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+
+	std::string escapeJson(std::string_view string) {
+		std::string escaped;
+		for (const char c : string) {
+			if (c == '"' || c == '\\') escaped.push_back('\\');
+			if (c == '\n') escaped += "\\n";
+			else if (c == '\t') escaped += "\\t";
+			else if (static_cast<unsigned char>(c) < 0x20) escaped += ' ';
+			else escaped.push_back(c);
+		}
+		return escaped;
+	}
+
+	/// @brief Request id as JSON (numbers and strings are echoed, everything else becomes null).
+	std::string formatId(const JsonValue& id) {
+		if (const auto number = std::get_if<double>(&id.value)) return std::format("{}", *number);
+		if (const auto string = std::get_if<std::string>(&id.value)) return std::format("\"{}\"", escapeJson(*string));
+		return "null";
+	}
+
+
+	double getNumber(const JsonValue& params, std::string_view key, double defaultValue) {
+		const auto member = params.find(key);
+		if (!member) return defaultValue;
+		const auto number = std::get_if<double>(&member->value);
+		if (!number) throw RequestError(std::format("The parameter \"{}\" needs to be a number", key));
+		return *number;
+	}
+
+	int64_t getInteger(const JsonValue& params, std::string_view key, int64_t defaultValue, int64_t min, int64_t max) {
+		const auto number = getNumber(params, key, static_cast<double>(defaultValue));
+		if (number != std::floor(number) || number < min || number > max)
+			throw RequestError(std::format("The parameter \"{}\" needs to be an integer between {} and {}", key, min, max));
+		return static_cast<int64_t>(number);
+	}
+
+	bool getBool(const JsonValue& params, std::string_view key, bool defaultValue) {
+		const auto member = params.find(key);
+		if (!member) return defaultValue;
+		const auto value = std::get_if<bool>(&member->value);
+		if (!value) throw RequestError(std::format("The parameter \"{}\" needs to be true or false", key));
+		return *value;
+	}
+
+
+	Hamiltonian getHamiltonian(const JsonValue& params) {
+		const auto member = params.find("hamiltonian");
+		if (!member) throw RequestError("No \"hamiltonian\" given");
+		const auto terms = std::get_if<JsonValue::Object>(&member->value);
+		if (!terms || terms->empty()) throw RequestError("The \"hamiltonian\" needs to be a non-empty object of Pauli strings and coefficients");
+
+		Hamiltonian hamiltonian;
+		hamiltonian.operators.reserve(terms->size());
+		for (const auto& [pauliString, coefficient] : *terms) {
+			const size_t letters = pauliString.starts_with("-i") ? 2 : pauliString.starts_with('-') || pauliString.starts_with('i') ? 1 : 0;
+			if (pauliString.size() == letters || pauliString.find_first_not_of("IXYZ", letters) != std::string::npos)
+				throw RequestError(std::format("Invalid Pauli string \"{}\"", pauliString));
+			if (pauliString.size() - letters > 64) throw RequestError("Paulis with more than 64 qubits are currently not supported");
+			const auto value = std::get_if<double>(&coefficient.value);
+			if (!value) throw RequestError(std::format("The coefficient of {} needs to be a number", pauliString));
+
+			Pauli pauli{ pauliString };
+			if (hamiltonian.numQubits == 0) hamiltonian.numQubits = pauli.numQubits();
+			else if (hamiltonian.numQubits != pauli.numQubits())
+				throw RequestError(std::format("The Pauli {} does not have the same number of qubits as the preceding Paulis", pauliString));
+			hamiltonian.operators.emplace_back(pauli, *value);
+		}
+		return hamiltonian;
+	}
+
+
+	Graph<> getConnectivity(const JsonValue& params, int numQubits) {
+		const auto member = params.find("connectivity");
+		if (!member) return Graph<>::linear(numQubits);
+		if (const auto type = std::get_if<std::string>(&member->value)) {
+			if (*type == "linear") return Graph<>::linear(numQubits);
+			if (*type == "cycle") return Graph<>::cycle(numQubits);
+			if (*type == "star") return Graph<>::star(numQubits);
+			throw RequestError("The \"connectivity\" can only be linear, cycle, star or a list of edges");
+		}
+		const auto edges = std::get_if<JsonValue::Array>(&member->value);
+		if (!edges) throw RequestError("The \"connectivity\" can only be linear, cycle, star or a list of edges");
+
+		Graph<> graph{ numQubits };
+		for (const auto& edge : *edges) {
+			const auto vertices = std::get_if<JsonValue::Array>(&edge.value);
+			if (!vertices || vertices->size() != 2) throw RequestError("Each edge of the \"connectivity\" needs to be a pair of qubits");
+			const auto i = std::get_if<double>(&(*vertices)[0].value);
+			const auto j = std::get_if<double>(&(*vertices)[1].value);
+			const auto isQubit = [&](const double* qubit) { return qubit && *qubit == std::floor(*qubit) && *qubit >= 0 && *qubit < numQubits; };
+			if (!isQubit(i) || !isQubit(j) || *i == *j) throw RequestError(std::format("Invalid edge in \"connectivity\" for {} qubits", numQubits));
+			graph.addEdge(static_cast<int>(*i), static_cast<int>(*j));
+		}
+		return graph;
+	}
+
+
+	class Daemon {
+	public:
+		explicit Daemon(std::ostream& responses) : responses(responses) {}
+
+		/// @brief Handle a request line, returns false after a shutdown request.
+		bool handle(std::string_view line) {
+			JsonValue id{ nullptr };
+			try {
+				const auto request = JsonParser{ line }.parseDocument();
+				if (!std::holds_alternative<JsonValue::Object>(request.value)) throw RequestError("A request needs to be a JSON object");
+				if (const auto requestId = request.find("id")) id = *requestId;
+
+				const auto method = request.find("method");
+				if (!method || !std::holds_alternative<std::string>(method->value)) throw RequestError("No \"method\" given");
+				const auto params = request.find("params");
+				const JsonValue noParams{ JsonValue::Object{} };
+				if (params && !std::holds_alternative<JsonValue::Object>(params->value)) throw RequestError("The \"params\" need to be an object");
+
+				++numRequests;
+				const auto& name = std::get<std::string>(method->value);
+				if (name == "group") group(id, params ? *params : noParams);
+				else if (name == "status") status(id);
+				else if (name == "shutdown") {
+					writeLine(std::format("{{\"id\": {}, \"result\": {{}}}}", formatId(id)));
+					return false;
+				}
+				else throw RequestError(std::format("Unknown method \"{}\"", name));
+			}
+			catch (std::exception& e) {
+				writeLine(std::format("{{\"id\": {}, \"error\": {{\"message\": \"{}\"}}}}", formatId(id), escapeJson(e.what())));
+			}
+			return true;
+		}
+
+	private:
+		// qubits, connectivity edges, numGraphs, maxEdgeCount, seed
+		using GraphSetKey = std::tuple<int, std::vector<std::pair<int, int>>, int64_t, int64_t, uint64_t>;
+
+		void group(const JsonValue& id, const JsonValue& params) {
+			using clock = std::chrono::steady_clock;
+			const auto t0 = clock::now();
+
+			const auto hamiltonian = getHamiltonian(params);
+			const auto numQubits = hamiltonian.numQubits;
+			const auto connectivity = getConnectivity(params, numQubits);
+			const auto numGraphs = getInteger(params, "numGraphs", 100, 1, std::numeric_limits<int32_t>::max());
+			const auto maxEdgeCount = getInteger(params, "maxEdgeCount", 1000, 1, std::numeric_limits<int32_t>::max());
+			const auto requestedSeed = static_cast<uint64_t>(getInteger(params, "seed", 0, 0, std::numeric_limits<uint32_t>::max()));
+			const auto seed = requestedSeed == 0 ? std::random_device{}() : requestedSeed;
+
+			// Graph sets with a fixed seed are kept for later requests
+			const GraphSetKey key{ numQubits, connectivity.getEdges(), numGraphs, maxEdgeCount, seed };
+			auto cached = graphSets.find(key);
+			std::vector<Graph<>> generatedGraphs;
+			if (cached == graphSets.end()) {
+				std::mt19937_64 randomGenerator{ seed };
+				generatedGraphs = getRandomSubgraphs(connectivity, numGraphs, static_cast<int>(maxEdgeCount), randomGenerator);
+				std::ranges::sort(generatedGraphs, std::less{}, &Graph<>::edgeCount);
+				if (requestedSeed != 0) {
+					cached = graphSets.emplace(key, std::move(generatedGraphs)).first;
+					graphSetOrder.push_back(cached);
+					// The oldest graph set is evicted first (never the one just inserted)
+					if (graphSetOrder.size() > maxGraphSets) {
+						graphSets.erase(graphSetOrder.front());
+						graphSetOrder.pop_front();
+					}
+				}
+			}
+			const auto& graphs = cached != graphSets.end() ? cached->second : generatedGraphs;
+
+			GrouperOptions options{
+				.numThreads = static_cast<int>(getInteger(params, "numThreads", 1, 1, 255)),
+				.verbose = getBool(params, "verbose", false),
+				.timeBudget = getNumber(params, "deadline", 0.),
+				.numMainPaulis = static_cast<int>(getInteger(params, "numMainPaulis", 1, 1, 255)),
+				.seed = seed,
+				.tailThreshold = getNumber(params, "tailThreshold", 0.),
+				.finders = &finders[numQubits]
+			};
+			if (options.timeBudget < 0 || options.tailThreshold < 0) throw RequestError("The \"deadline\" and \"tailThreshold\" cannot be negative");
+
+			size_t numGroupsSent{};
+			std::string line;
+			options.onCollection = [&](const CollectionWithGraph& collection) {
+				line.clear();
+				auto out = std::back_inserter(line);
+				std::format_to(out, "{{\"id\": {}, \"group\": {{\"index\": {}, ", formatId(id), numGroupsSent++);
+				JsonFormatting::printPauliCollectionFields(out, collection);
+				std::format_to(out, "}}}}");
+				writeLine(line);
+			};
+			const auto grouping = applyPauliGrouper2Multithread2(hamiltonian, graphs, options);
+
+			const auto seconds = std::chrono::duration<double>(clock::now() - t0).count();
+			line.clear();
+			auto out = std::back_inserter(line);
+			std::format_to(out, "{{\"id\": {}, \"result\": {{\"num groups\": {}, \"runtime [seconds]\": {}, \"num graphs\": {}, \"random seed\": {}, \"R_hat\": ",
+				formatId(id), grouping.size(), seconds, graphs.size(), seed);
+			// R_hat is not finite f.e. for a hamiltonian with only the identity term
+			JsonFormatting::printNumber(out, estimated_shot_reduction(hamiltonian, grouping));
+			std::format_to(out, ", \"grouping\": [");
+			for (size_t i = 0; i < grouping.size(); ++i) {
+				std::format_to(out, "{}{{", i == 0 ? "" : ",");
+				JsonFormatting::printPauliCollectionFields(out, grouping[i]);
+				std::format_to(out, "}}");
+			}
+			std::format_to(out, "]}}}}");
+			writeLine(line);
+		}
+
+		void status(const JsonValue& id) {
+			std::string line;
+			auto out = std::back_inserter(line);
+			std::format_to(out, "{{\"id\": {}, \"result\": {{\"requests\": {}, \"solvers\": {{", formatId(id), numRequests);
+			bool first = true;
+			for (const auto& [numQubits, pool] : finders) {
+				std::format_to(out, "{}\"{}\": {}", first ? "" : ", ", numQubits, pool.size());
+				first = false;
+			}
+			std::format_to(out, "}}, \"cached graph sets\": {}}}}}", graphSets.size());
+			writeLine(line);
+		}
+
+		void writeLine(std::string_view line) {
+			responses << line << '\n';
+			responses.flush();
+		}
+
+		std::ostream& responses;
+		// Solver instances for each number of qubits, extended to the largest number of threads requested
+		std::map<int, std::vector<HTCircuitFinder>> finders;
+		// Graph sets of requests with a fixed seed, at most maxGraphSets in insertion order
+		static constexpr size_t maxGraphSets = 64;
+		std::map<GraphSetKey, std::vector<Graph<>>> graphSets;
+		std::deque<std::map<GraphSetKey, std::vector<Graph<>>>::iterator> graphSetOrder;
+		size_t numRequests{};
+	};
+}
+
+
+int main() {
+	// The grouper logs with println(), responses go to the original stdout
+	std::ostream responses{ std::cout.rdbuf(std::cerr.rdbuf()) };
+	Daemon daemon{ responses };
+
+	std::string line;
+	while (std::getline(std::cin, line)) {
+		if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+		if (!daemon.handle(line)) break;
+	}
+	return 0;
+}
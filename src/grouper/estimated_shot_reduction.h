@@ -1,6 +1,8 @@
 ﻿#pragma once
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include "hamiltonian.h"
 
 
@@ -17,7 +19,7 @@ namespace Q {
 	/// @param hamiltonian Hamiltonian 
 	/// @param grouping    Grouping of the operators in hamiltonian
 	/// @return            Estimated shot reduction
-	double estimated_shot_reduction(const Hamiltonian& hamiltonian, const std::vector<CollectionWithGraph>& grouping) {
+	inline double estimated_shot_reduction(const Hamiltonian& hamiltonian, const std::vector<CollectionWithGraph>& grouping) {
 		double numerator{};
 		double denominator{};
 
@@ -36,4 +38,30 @@ namespace Q {
 		return numerator * numerator / (denominator * denominator);
 	}
 
+	/// @brief Upper bound for the estimated shot reduction of any grouping that places the Paulis with |coefficient| 
+	///        at least @p tailThreshold as in @p grouping, no matter where the Paulis below the threshold go. Placing
+	///        a Pauli can only raise the denominator, so the bound is obtained by leaving the tail Paulis out of the 
+	///        denominator. The difference to estimated_shot_reduction() bounds the loss due to the cheap treatment of 
+	///        the tail (see GrouperOptions::tailThreshold). Infinite if all measured Paulis are below the threshold 
+	///        (0 if there are none). 
+	inline double estimated_shot_reduction_bound(const Hamiltonian& hamiltonian, const std::vector<CollectionWithGraph>& grouping, double tailThreshold) {
+		double numerator{};
+		double denominator{};
+
+		for (const auto& group : grouping) {
+			double denominatorTerm{};
+			for (const auto& pauli : group.paulis) {
+				if (pauli == Pauli::Identity(hamiltonian.numQubits)) continue; // no need to measure identity
+
+				auto coefficient = std::get<double>(*std::ranges::find(hamiltonian.operators, pauli, [](const auto& a) { return std::get<0>(a); }));
+				double absolute = std::abs(coefficient);
+				numerator += absolute;
+				if (absolute >= tailThreshold) denominatorTerm += absolute * absolute;
+			}
+			denominator += std::sqrt(denominatorTerm);
+		}
+		if (denominator == 0) return numerator == 0 ? 0. : std::numeric_limits<double>::infinity();
+		return numerator * numerator / (denominator * denominator);
+	}
+
 }
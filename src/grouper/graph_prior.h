@@ -0,0 +1,147 @@
+#pragma once
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <charconv>
+#include "string_utility.h"
+#include "pauli_grouper.h"
+
+namespace Q {
+
+
+	class GraphPriorError : public std::runtime_error {
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+
+	/// @brief Graphs that won in previous runs together with their number of wins.
+	///
+	///        Graphs are stored as 64-bit codes with bit j set if the graph contains edges[j]. The reference
+	///        edges are written to the file as well so that a prior stays valid for other connectivities. Edges are 
+	///        added when a graph that contains them wins, at most 64 different edges are supported. 
+	///
+	///        File format:
+	///
+	///            qubits <number of qubits>
+	///            edges <i>-<j> <i>-<j> ...
+	///            <code> <wins>
+	///            ...
+	///
+	///        Lines starting with # are ignored.
+	struct GraphPrior {
+		int numQubits{};
+		std::vector<std::pair<int, int>> edges;
+		// Number of wins for each graph code
+		std::map<uint64_t, size_t> wins;
+
+		/// @brief Count the (non-edgeless) graphs of the given grouping as wins.
+		void addWins(const std::vector<CollectionWithGraph>& grouping) {
+			for (const auto& collection : grouping) {
+				if (collection.graph.edgeCount() == 0) continue;
+				++wins[encode(collection.graph)];
+			}
+		}
+
+		/// @brief Get the graphs of the prior sorted by number of wins (most first). Graphs that are not subgraphs of
+		///        given connectivity or have more than maxEdgeCount edges are left out.
+		std::vector<Graph<>> getGraphs(const Graph<>& connectivity, int64_t maxEdgeCount) const {
+			std::vector<std::pair<uint64_t, size_t>> sortedWins(wins.begin(), wins.end());
+			std::ranges::stable_sort(sortedWins, std::greater{}, [](const auto& a) { return a.second; });
+
+			std::vector<Graph<>> graphs;
+			for (const auto& [code, _] : sortedWins) {
+				Graph<> graph(numQubits);
+				bool valid = std::popcount(code) <= maxEdgeCount;
+				for (size_t j = 0; j < std::min<size_t>(edges.size(), 64) && valid; ++j) {
+					if (!(code & (1ULL << j))) continue;
+					if (!connectivity.hasEdge(edges[j].first, edges[j].second)) valid = false;
+					else graph.addEdge(edges[j].first, edges[j].second);
+				}
+				if (valid) graphs.push_back(graph);
+			}
+			return graphs;
+		}
+
+	private:
+		uint64_t encode(const Graph<>& graph) {
+			if (edges.size() > 64) throw GraphPriorError("Graph priors can contain at most 64 different edges");
+			uint64_t code{};
+			for (const auto& edge : graph.getEdges()) {
+				auto it = std::ranges::find(edges, edge);
+				if (it == edges.end()) {
+					if (edges.size() == 64) throw GraphPriorError("Graph priors can contain at most 64 different edges");
+					it = edges.insert(edges.end(), edge);
+				}
+				code |= 1ULL << (it - edges.begin());
+			}
+			return code;
+		}
+	};
+
+
+	inline GraphPrior readGraphPrior(const std::string& filename) {
+		std::ifstream file{ filename };
+		if (!file) throw GraphPriorError(std::format("Could not open file \"{}\"", filename));
+
+		auto toInt = [](std::string_view text) {
+			int value{};
+			const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+			if (error != std::errc{} || end != text.data() + text.size()) throw GraphPriorError(std::format("Invalid number \"{}\" in graph prior", text));
+			return value;
+		};
+
+		GraphPrior prior;
+		std::string line;
+		while (std::getline(file, line)) {
+			line = trim(line, " \t\r");
+			if (line.empty() || line.starts_with('#')) continue;
+
+			std::istringstream stream{ line };
+			std::string keyword;
+			stream >> keyword;
+			if (keyword == "qubits") {
+				std::string numQubits;
+				stream >> numQubits;
+				prior.numQubits = toInt(numQubits);
+				if (prior.numQubits < 1 || prior.numQubits > 64) throw GraphPriorError(std::format("Invalid number of qubits {} in graph prior", prior.numQubits));
+			}
+			else if (keyword == "edges") {
+				std::string edge;
+				while (stream >> edge) {
+					auto vertices = split(edge, '-');
+					if (vertices.size() != 2) throw GraphPriorError(std::format("Invalid edge \"{}\" in graph prior", edge));
+					prior.edges.emplace_back(toInt(vertices[0]), toInt(vertices[1]));
+				}
+				if (prior.edges.size() > 64) throw GraphPriorError("Graph priors can contain at most 64 different edges");
+			}
+			else {
+				uint64_t code{};
+				size_t wins{};
+				if (!(std::istringstream{ line } >> code >> wins)) throw GraphPriorError(std::format("Invalid line \"{}\" in graph prior", line));
+				if (prior.edges.size() < 64 && code >> prior.edges.size() != 0) throw GraphPriorError(std::format("Graph code {} refers to unknown edges", code));
+				prior.wins[code] += wins;
+			}
+		}
+		if (prior.numQubits == 0) throw GraphPriorError("No number of qubits specified in graph prior");
+		for (const auto& [i, j] : prior.edges) {
+			if (i < 0 || j < 0 || i >= prior.numQubits || j >= prior.numQubits || i == j) 
+				throw GraphPriorError(std::format("Invalid edge {}-{} in graph prior with {} qubits", i, j, prior.numQubits));
+		}
+		return prior;
+	}
+
+
+	inline void writeGraphPrior(const std::string& filename, const GraphPrior& prior) {
+		std::ofstream file{ filename };
+		if (!file) throw GraphPriorError(std::format("Could not open file \"{}\"", filename));
+
+		file << "# Graph prior: winning graphs as codes over the edges below and their number of wins\n";
+		file << "qubits " << prior.numQubits << "\nedges";
+		for (const auto& [i, j] : prior.edges) file << ' ' << i << '-' << j;
+		file << '\n';
+		for (const auto& [code, wins] : prior.wins) file << code << ' ' << wins << '\n';
+	}
+
+}
@@ -1,5 +1,8 @@
 ﻿#pragma once
+#include <cmath>
 #include <format>
+#include <fstream>
+#include <string>
 #include "graph.h"
 
 namespace JsonFormatting {
@@ -10,8 +13,22 @@ namespace JsonFormatting {
 		size_t numGraphs{};
 		size_t randomSeed{};
 		Q::Graph<> connectivity;
+		// Number of graphs evaluated in each iteration of the grouper (omitted if empty)
+		std::vector<size_t> graphsEvaluated;
+		// Coefficient threshold of the tail terms and bound on the loss in R_hat due to them (omitted if 0)
+		double tailThreshold{};
+		double rHatLossBound{};
+		// Whether the groups are measurable with their edges and single-qubit layers. Baselines with general 
+		// commutation are not, their groups are written with "cliffords": null. 
+		bool measurable{ true };
 	};
 
+	/// @brief Print a number, or null if it is not finite (JSON has no inf or nan). 
+	void printNumber(auto out, double value) {
+		if (std::isfinite(value)) std::format_to(out, "{}", value);
+		else std::format_to(out, "null");
+	}
+
 	void printEdgeList(auto out, const std::vector<std::pair<int, int>>& edges) {
 		for (size_t i = 0; i < edges.size(); ++i) {
 			std::format_to(out, "[{},{}]", edges[i].first, edges[i].second);
@@ -22,7 +39,23 @@ namespace JsonFormatting {
 	}
 
 
-	void printPauliCollection(auto out, const auto& collection) {
+	void printCliffords(auto out, const auto& singleQubitLayer) {
+		for (size_t i = 0; i < singleQubitLayer.size(); ++i) {
+			const auto& gate = singleQubitLayer[i];
+			if (gate == Q::BinaryCliffordGates::I) std::format_to(out, "\"I\"");
+			if (gate == Q::BinaryCliffordGates::H) std::format_to(out, "\"H\"");
+			if (gate == Q::BinaryCliffordGates::S) std::format_to(out, "\"S\"");
+			if (gate == Q::BinaryCliffordGates::SH) std::format_to(out, "\"SH\"");
+			if (gate == Q::BinaryCliffordGates::HSH) std::format_to(out, "\"HSH\"");
+			if (gate == Q::BinaryCliffordGates::HS) std::format_to(out, "\"HS\"");
+			if (i != singleQubitLayer.size() - 1) {
+				std::format_to(out, ",");
+			}
+		}
+	}
+
+
+	void printPauliCollection(auto out, const auto& collection, bool measurable = true) {
 		std::format_to(out, "    {{\n      \"operators\": [");
 
 		for (size_t i = 0; i < collection.paulis.size(); ++i) {
@@ -33,21 +66,32 @@ namespace JsonFormatting {
 		}
 		std::format_to(out, "],\n      \"edges\": [");
 		printEdgeList(out, collection.graph.getEdges());
+		if (!measurable) {
+			std::format_to(out, "],\n      \"cliffords\": null\n    }}");
+			return;
+		}
 		std::format_to(out, "],\n      \"cliffords\": [");
 
-		for (size_t i = 0; i < collection.singleQubitLayer.size(); ++i) {
-			const auto& gate = collection.singleQubitLayer[i];
-			if (gate == Q::BinaryCliffordGates::I) std::format_to(out, "\"I\"");
-			if (gate == Q::BinaryCliffordGates::H) std::format_to(out, "\"H\"");
-			if (gate == Q::BinaryCliffordGates::S) std::format_to(out, "\"S\"");
-			if (gate == Q::BinaryCliffordGates::SH) std::format_to(out, "\"SH\"");
-			if (gate == Q::BinaryCliffordGates::HSH) std::format_to(out, "\"HSH\"");
-			if (gate == Q::BinaryCliffordGates::HS) std::format_to(out, "\"HS\"");
-			if (i != collection.singleQubitLayer.size() - 1) {
+		printCliffords(out, collection.singleQubitLayer);
+		std::format_to(out, "]\n    }}");
+	}
+
+
+	/// @brief Print the members of a collection on a single line (without braces): 
+	///        "operators": ["XXI","YYI"], "edges": [[0,1]], "cliffords": ["H","S","I"]
+	void printPauliCollectionFields(auto out, const auto& collection) {
+		std::format_to(out, "\"operators\": [");
+		for (size_t i = 0; i < collection.paulis.size(); ++i) {
+			std::format_to(out, "\"{}\"", collection.paulis[i]);
+			if (i != collection.paulis.size() - 1) {
 				std::format_to(out, ",");
 			}
 		}
-		std::format_to(out, "]\n    }}");
+		std::format_to(out, "], \"edges\": [");
+		printEdgeList(out, collection.graph.getEdges());
+		std::format_to(out, "], \"cliffords\": [");
+		printCliffords(out, collection.singleQubitLayer);
+		std::format_to(out, "]");
 	}
 
 
@@ -60,13 +104,29 @@ namespace JsonFormatting {
 		printEdgeList(out, metaInfo.connectivity.getEdges());
 		std::format_to(out, "],\n", metaInfo.numGraphs);
 		std::format_to(out, "  \"random seed\": {},\n", metaInfo.randomSeed);
+		if (!metaInfo.graphsEvaluated.empty()) {
+			std::format_to(out, "  \"graphs evaluated\": [");
+			for (size_t i = 0; i < metaInfo.graphsEvaluated.size(); ++i) {
+				std::format_to(out, "{}", metaInfo.graphsEvaluated[i]);
+				if (i != metaInfo.graphsEvaluated.size() - 1) {
+					std::format_to(out, ",");
+				}
+			}
+			std::format_to(out, "],\n");
+		}
+		if (metaInfo.tailThreshold > 0) {
+			std::format_to(out, "  \"tail threshold\": {},\n", metaInfo.tailThreshold);
+			std::format_to(out, "  \"R_hat loss bound\": ");
+			printNumber(out, metaInfo.rHatLossBound);
+			std::format_to(out, ",\n");
+		}
 
 		//auto mat = metaInfo.connectivity.getAdjacencyMatrix();
 		//for(int i=0; i < )
 
 		std::format_to(out, "  \"grouping\": [\n");
 		for (size_t i = 0; i < collections.size(); ++i) {
-			printPauliCollection(out, collections[i]);
+			printPauliCollection(out, collections[i], metaInfo.measurable);
 			if (i != collections.size() - 1) {
 				std::format_to(out, ",\n");
 			}
@@ -75,4 +135,65 @@ namespace JsonFormatting {
 	}
 
 
-}
\ No newline at end of file
+	/// @brief Writes the groups of a running grouper as JSON Lines, one group per line as soon as it is accepted:
+	///
+	///            {"index": 0, "operators": ["XXI","YYI"], "edges": [[0,1]], "cliffords": ["H","S","I"]}
+	///
+	///        and a summary line at the end: {"summary": {"num groups": 12, ...}}. A group is written again with the
+	///        same index if it changed afterwards (f.e. through tail insertion or refinement), so readers should keep
+	///        the last line for each index and drop indices from "num groups" on. Each line is formatted into a buffer
+	///        and written and flushed at once.
+	class JsonLinesWriter {
+	public:
+		explicit JsonLinesWriter(const std::string& filename) : file(filename, std::ios::binary | std::ios::trunc) {
+			if (!file) throw std::runtime_error(std::format("Could not open file \"{}\"", filename));
+		}
+
+		/// @brief Append the next group. 
+		void write(const auto& collection) {
+			writeGroup(written.size(), collection);
+		}
+
+		/// @brief Write the groups of the final grouping that differ from the ones written before and the summary.
+		void finish(const auto& collections, const MetaInfo& metaInfo, double R_hat) {
+			for (size_t i = 0; i < collections.size(); ++i) writeGroup(i, collections[i]);
+
+			buffer.clear();
+			auto out = std::back_inserter(buffer);
+			std::format_to(out, "{{\"summary\": {{\"num groups\": {}, \"runtime [seconds]\": {}, \"num graphs\": {}, \"random seed\": {}, \"R_hat\": ",
+				collections.size(), metaInfo.timeInSeconds, metaInfo.numGraphs, metaInfo.randomSeed);
+			printNumber(out, R_hat);
+			if (metaInfo.tailThreshold > 0) {
+				std::format_to(out, ", \"tail threshold\": {}, \"R_hat loss bound\": ", metaInfo.tailThreshold);
+				printNumber(out, metaInfo.rHatLossBound);
+			}
+			std::format_to(out, "}}}}\n");
+			writeLine();
+		}
+
+	private:
+		void writeGroup(size_t index, const auto& collection) {
+			std::string group;
+			printPauliCollectionFields(std::back_inserter(group), collection);
+
+			if (index < written.size() && written[index] == group) return;
+			if (index >= written.size()) written.resize(index + 1);
+
+			buffer.clear();
+			std::format_to(std::back_inserter(buffer), "{{\"index\": {}, {}}}\n", index, group);
+			writeLine();
+			written[index] = std::move(group);
+		}
+
+		void writeLine() {
+			file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			file.flush();
+		}
+
+		std::ofstream file;
+		std::string buffer;
+		// Content of the last line written for each index
+		std::vector<std::string> written;
+	};
+
+}
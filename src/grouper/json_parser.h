@@ -0,0 +1,170 @@
+#pragma once
+#include <charconv>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace Q {
+
+
+	class JsonParseError : public std::runtime_error {
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+
+	struct JsonValue {
+		using Array = std::vector<JsonValue>;
+		using Object = std::vector<std::pair<std::string, JsonValue>>;
+		std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value;
+
+		/// @brief Member of an object with given key or nullptr (also if this is no object).
+		const JsonValue* find(std::string_view key) const {
+			if (const auto object = std::get_if<Object>(&value)) {
+				for (const auto& [name, member] : *object) {
+					if (name == key) return &member;
+				}
+			}
+			return nullptr;
+		}
+	};
+
+
+	/// @brief Minimal JSON parser for single-line documents (f.e. requests of the grouper daemon). Strings may only 
+	///        contain ASCII escape sequences (no \u). Errors are reported as JsonParseError with the column. 
+	class JsonParser {
+	public:
+		// Arrays and objects nested deeper than this are rejected instead of overflowing the stack
+		static constexpr int maxDepth = 256;
+
+		explicit JsonParser(std::string_view text) : text(text) {}
+
+		JsonValue parseDocument() {
+			auto value = parseValue();
+			skipWhitespace();
+			if (p != text.size()) fail("Unexpected characters after the document");
+			return value;
+		}
+
+	private:
+		JsonValue parseValue() {
+			skipWhitespace();
+			if (p == text.size()) fail("Unexpected end of document");
+			switch (text[p]) {
+			case '{': return parseObject();
+			case '[': return parseArray();
+			case '"': return { parseString() };
+			case 't': expect("true"); return { true };
+			case 'f': expect("false"); return { false };
+			case 'n': expect("null"); return { nullptr };
+			}
+			// from_chars would also accept inf and nan
+			if (text[p] != '-' && (text[p] < '0' || text[p] > '9')) fail("Invalid value");
+			double number{};
+			const auto [next, ec] = std::from_chars(text.data() + p, text.data() + text.size(), number);
+			if (ec != std::errc{}) fail("Invalid value");
+			p = static_cast<size_t>(next - text.data());
+			return { number };
+		}
+
+		JsonValue parseObject() {
+			enter();
+			++p;
+			JsonValue::Object object;
+			skipWhitespace();
+			if (p < text.size() && text[p] == '}') {
+				++p;
+				--depth;
+				return { std::move(object) };
+			}
+			while (true) {
+				skipWhitespace();
+				if (p == text.size() || text[p] != '"') fail("Expected a key in double quotes");
+				auto key = parseString();
+				skipWhitespace();
+				if (p == text.size() || text[p] != ':') fail("Expected ':'");
+				++p;
+				object.emplace_back(std::move(key), parseValue());
+				skipWhitespace();
+				if (p == text.size()) fail("Expected ',' or '}'");
+				if (text[p++] == '}') {
+					--depth;
+					return { std::move(object) };
+				}
+				if (text[p - 1] != ',') fail("Expected ',' or '}'");
+			}
+		}
+
+		JsonValue parseArray() {
+			enter();
+			++p;
+			JsonValue::Array array;
+			skipWhitespace();
+			if (p < text.size() && text[p] == ']') {
+				++p;
+				--depth;
+				return { std::move(array) };
+			}
+			while (true) {
+				array.push_back(parseValue());
+				skipWhitespace();
+				if (p == text.size()) fail("Expected ',' or ']'");
+				if (text[p++] == ']') {
+					--depth;
+					return { std::move(array) };
+				}
+				if (text[p - 1] != ',') fail("Expected ',' or ']'");
+			}
+		}
+
+		std::string parseString() {
+			++p;
+			std::string string;
+			while (true) {
+				if (p == text.size()) fail("Unterminated string");
+				const char c = text[p++];
+				if (c == '"') return string;
+				if (c != '\\') {
+					string.push_back(c);
+					continue;
+				}
+				if (p == text.size()) fail("Unterminated string");
+				switch (const char escaped = text[p++]) {
+				case '"': case '\\': case '/': string.push_back(escaped); break;
+				case 'n': string.push_back('\n'); break;
+				case 't': string.push_back('\t'); break;
+				case 'r': string.push_back('\r'); break;
+				case 'b': string.push_back('\b'); break;
+				case 'f': string.push_back('\f'); break;
+				default: fail("Unsupported escape sequence");
+				}
+			}
+		}
+
+		void enter() {
+			if (++depth > maxDepth) fail("Nesting too deep");
+		}
+
+		void expect(std::string_view literal) {
+			if (!text.substr(p).starts_with(literal)) fail("Invalid value");
+			p += literal.size();
+		}
+
+		void skipWhitespace() {
+			while (p < text.size() && (text[p] == ' ' || text[p] == '\t' || text[p] == '\r' || text[p] == '\n')) ++p;
+		}
+
+		[[noreturn]] void fail(std::string_view message) const {
+			throw JsonParseError(std::format("{} at column {}", message, p + 1));
+		}
+
+		std::string_view text;
+		size_t p{};
+		int depth{};
+	};
+
+}
@@ -1,12 +1,28 @@
 ﻿
 #include "read_hamiltonians.h"
+#include "binary_hamiltonian.h"
 #include "pauli_grouper.h"
 #include "json_formatting.h"
 #include "estimated_shot_reduction.h"
+#include "baseline_groupers.h"
+#include "sharded_grouper.h"
+#include "find_ht_circuit.h"
+#include "graph_prior.h"
+#include "checkpoint.h"
 #include "data_path.h"
 #include "read_config.h"
+#include "subgraph_sampling.h"
 #include <random>
 #include <chrono>
+#include <filesystem>
+#include <optional>
+#include <future>
+#include <map>
+#include <set>
+#include <tuple>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 using namespace Q;
 
@@ -18,127 +34,528 @@ std::string toAbsolutePath(const std::string& filename) {
 }
 
 
-template<class RNG>
-auto getRandomSubgraphs(const Graph<>& graph, int64_t num, int maxEdgeCount, RNG&& rng) {
-	const auto edgeCount = graph.edgeCount();
-	if (edgeCount <= 63) {
-		// Check if num wanted graphs is greater or equal the total number of subgraphs
-		// then we just return all subgraphs 
-		const uint64_t totalNumSubgraphs = 1ULL << edgeCount;
-		if (num >= totalNumSubgraphs) {
-			return generateSubgraphs(graph, 0, maxEdgeCount);
-		}
-		else {
-			auto edges = graph.getEdges();
-			auto edgeMask = (1ULL << edgeCount) - 1;
-			std::vector<Graph<>> subgraphs;
-			while(subgraphs.size() < num) {
-				uint64_t randomInt = rng() & edgeMask;
-				if (const auto ec = std::popcount(randomInt); ec > maxEdgeCount) continue;
-
-				Graph<> subgraph(graph.graphSize);
-				for (size_t j = 0; j < edges.size(); ++j) {
-					if (randomInt & (1ULL << j)) {
-						subgraph.addEdge(edges[j].first, edges[j].second);
-					}
-				}
-				subgraphs.push_back(subgraph);
+/// @brief Data that is reused by the runs of a batch or sweep: sampled graph sets (before the graph prior is applied), 
+///        solver instances for each number of qubits, the graph prior and, in a sweep, the collections found so far. 
+///        The wins of all runs are collected in one output prior per number of qubits, written once at the end. 
+struct SharedSetup {
+	using GraphSetKey = std::tuple<int, std::vector<std::pair<int, int>>, int64_t, uint64_t>; // qubits, connectivity edges, numGraphs, seed
+	std::map<GraphSetKey, std::vector<Graph<>>> graphSets;
+	std::map<int, std::vector<HTCircuitFinder>> finders;
+	std::optional<CollectionCache> collectionCache;
+	std::optional<GraphPrior> inputPrior;
+	std::map<int, GraphPrior> outputPriors;
+};
+
+
+struct RunSummary {
+	size_t numGroups{};
+	size_t numGraphs{};
+	double R_hat{};
+};
+
+
+/// @brief Get the graph prior of config.graphPrior (read once) for a run on numQubits qubits. A batch job with another
+///        number of qubits than the prior runs without it, unless the prior is used exclusively. 
+GraphPrior getGraphPrior(const Configuration& config, int numQubits, SharedSetup& shared) {
+	if (config.graphPrior.empty()) return GraphPrior{ numQubits };
+	if (!shared.inputPrior) shared.inputPrior = readGraphPrior(toAbsolutePath(config.graphPrior));
+	if (shared.inputPrior->numQubits == numQubits) return *shared.inputPrior;
+
+	const auto message = std::format("The graph prior has {} qubits while the hamiltonian has {}", shared.inputPrior->numQubits, numQubits);
+	if (config.batch.empty() || config.graphPriorExclusive) throw GraphPriorError(message);
+	println("{}, running this job without the graph prior", message);
+	return GraphPrior{ numQubits };
+}
+
+
+/// @brief Write the output priors of all runs to config.graphPriorOutput. If the runs had different numbers of qubits 
+///        (in a batch), each prior goes to <graphPriorOutput stem>_<numQubits>_qubits<extension>. 
+void writeGraphPriors(const Configuration& config, const SharedSetup& shared) {
+	if (config.graphPriorOutput.empty()) return;
+	const std::filesystem::path output{ config.graphPriorOutput };
+	for (const auto& [numQubits, prior] : shared.outputPriors) {
+		const auto filename = shared.outputPriors.size() == 1 ? config.graphPriorOutput 
+			: (output.parent_path() / std::format("{}_{}_qubits{}", output.stem().string(), numQubits, output.extension().string())).generic_string();
+		writeGraphPrior(toAbsolutePath(filename), prior);
+		println("Graph prior with the wins of {} qubit runs written to {}", numQubits, filename);
+	}
+}
+
+
+/// @brief Sample the graphs for a run (or take the ones of an earlier run with the same setup) and put the graphs of 
+///        the prior in front. 
+std::vector<Graph<>> selectGraphs(const Configuration& config, const Graph<>& connectivity, const GraphPrior& prior, uint64_t seed, SharedSetup& shared) {
+	const auto numQubits = connectivity.numVertices();
+	std::mt19937_64 randomGenerator{ seed };
+	std::vector<Graph<>> selectedGraphs;
+
+	// Runs of a batch with the same connectivity, number of graphs and (fixed) seed sample the same graphs
+	const SharedSetup::GraphSetKey graphSetKey{ numQubits, connectivity.getEdges(), config.numGraphs, seed };
+	if (const auto cached = shared.graphSets.find(graphSetKey); cached != shared.graphSets.end()) {
+		selectedGraphs = cached->second;
+		println("Reusing {} sampled graphs of an earlier run", selectedGraphs.size());
+	}
+	else {
+		if (!config.graphPriorExclusive) {
+			if (config.maxComponentSize > 0 || config.componentShape != ComponentShape::Any) {
+				// Only subgraphs with small (or specially shaped) components, built directly from the connectivity
+				const auto maxComponentSize = config.maxComponentSize > 0 ? static_cast<int>(config.maxComponentSize) : numQubits;
+				selectedGraphs = getBoundedComponentSubgraphs(connectivity, config.numGraphs, static_cast<int>(config.maxEdgeCount), maxComponentSize, config.componentShape, randomGenerator);
+			}
+			else {
+				selectedGraphs = getRandomSubgraphs(connectivity, config.numGraphs, config.maxEdgeCount, randomGenerator);
 			}
-			return subgraphs;
 		}
+
+		if (config.sortGraphsByGrayCode) {
+			sortByGrayCode(selectedGraphs, connectivity);
+		}
+		else if (config.sortGraphsByEdgeCount) {
+			std::ranges::sort(selectedGraphs, std::less{}, &Graph<>::edgeCount);
+		}
+		if (config.seed != 0) shared.graphSets.emplace(graphSetKey, selectedGraphs);
 	}
-	else {
-		throw std::runtime_error("More than 63 edges are currently not supported");
+
+	// Graphs from the prior are evaluated first (most wins first)
+	if (!config.graphPrior.empty()) {
+		const auto priorGraphs = prior.getGraphs(connectivity, config.maxEdgeCount);
+		std::set<std::vector<std::pair<int, int>>> priorEdges;
+		for (const auto& graph : priorGraphs) priorEdges.insert(graph.getEdges());
+		std::erase_if(selectedGraphs, [&](const auto& graph) { return priorEdges.contains(graph.getEdges()); });
+		selectedGraphs.insert(selectedGraphs.begin(), priorGraphs.begin(), priorGraphs.end());
+		println("Using {} graphs from graph prior{}", priorGraphs.size(), config.graphPriorExclusive ? " exclusively" : " first");
 	}
+	return selectedGraphs;
 }
 
 
-int main() {
-	try {
+/// @brief Group the given hamiltonian as specified by the configuration and write the result to config.outfilename.
+RunSummary runGrouping(const Configuration& config, const Hamiltonian& hamiltonian, SharedSetup& shared) {
+	using clock = std::chrono::high_resolution_clock;
+	const auto t0 = clock::now();
 
-		Configuration config = readConfig(DATA_PATH "config.txt");
-		println(R"(Configuration:
-  filename = {}
-  outfilename = {}
-  connectivity = {}
-  numThreads = {}
-  maxEdgeCount = {}
-  numGraphs = {}
-  sortGraphsByEdgeCount = {}
-)", config.filename, config.outfilename, config.connectivity, config.numThreads, config.maxEdgeCount, config.numGraphs, config.sortGraphsByEdgeCount);
+	// Find a grouping of the hamiltonian into simultaneously measurable sets respecting
+	// a given hardware connectivity. 
 
+	auto outfilename = toAbsolutePath(config.outfilename);
+	auto connectivityFile = toAbsolutePath(config.connectivity);
 
-		using clock = std::chrono::high_resolution_clock;
-		const auto t0 = clock::now();
+	const auto numQubits = hamiltonian.numQubits;
 
-		// Read a hamiltonian consisting of Paulis together with weightings
-		// and find a grouping into simultaneously measurable sets respecting
-		// a given hardware connectivity. 
+	Connectivity connectivitySpec = readConnectivity(connectivityFile);
+	const auto connectivity = connectivitySpec.getGraph(numQubits);
+	println("Adjacency matrix:\n{}", connectivity.getAdjacencyMatrix());
 
-		auto filename = toAbsolutePath(config.filename);
-		auto outfilename = toAbsolutePath(config.outfilename);
-		auto connectivityFile = toAbsolutePath(config.connectivity);
+	if (config.algorithm != GroupingAlgorithm::HT && config.algorithm != GroupingAlgorithm::HTMerge) {
+		// Baselines do not depend on the connectivity, they are computed on the same data for comparison
+		println("Running baseline grouper with {} Paulis on {} qubits\n", hamiltonian.operators.size(), numQubits);
+		const auto heuristic = config.algorithm == GroupingAlgorithm::DSatur ? ColoringHeuristic::DSatur : ColoringHeuristic::LargestFirst;
+		auto grouping = config.algorithm == GroupingAlgorithm::SortedInsertion
+			? applySortedInsertion(hamiltonian, config.commutation)
+			: applyGraphColoring(hamiltonian, config.commutation, heuristic, static_cast<int>(config.numThreads));
 
-		const auto hamiltonian = readHamiltonianFromJson(filename);
-		const auto numQubits = hamiltonian.numQubits;
+		auto R_hat = estimated_shot_reduction(hamiltonian, grouping);
+		auto R_hat_tpb = estimated_shot_reduction(hamiltonian, applyTPBGrouper(hamiltonian));
 
-		Connectivity connectivitySpec = readConnectivity(connectivityFile);
-		const auto connectivity = connectivitySpec.getGraph(numQubits);
-		println("Adjacency matrix:\n{}", connectivity.getAdjacencyMatrix());
+		const auto t1 = clock::now();
+		const auto timeInSeconds = std::chrono::duration_cast<std::chrono::seconds>(t1 - t0).count();
+		println("Found grouping into {} subsets, run time: {}s", grouping.size(), timeInSeconds);
 
+		std::ofstream file{ outfilename };
+		auto fileout = std::ostream_iterator<char>(file);
+		JsonFormatting::printPauliCollections(fileout, grouping, JsonFormatting::MetaInfo{ 
+			.timeInSeconds = timeInSeconds, .connectivity = connectivity, .measurable = config.commutation == Commutation::QubitWise });
+		println("Estimated shot reduction\n R_hat = {}\n R_hat_TPB = {}\n R_hat/R_hat_TPB = {}", R_hat, R_hat_tpb, R_hat / R_hat_tpb);
+		return { grouping.size(), 0, R_hat };
+	}
 
-		// Generate all subgraphs of given graph with a maximum of [maxEdgeCount]edges
-		auto subgraphs = generateSubgraphs(connectivity, 0, config.maxEdgeCount);
 
-		//for (int starSize = 3; starSize < 8; ++starSize) {
-		//	for (int start = 0; start <= numQubits - starSize; ++start) {
-		//		Graph<> star{ numQubits };
-		//		for (int i = 0; i < starSize; ++i) {
-		//			star.addEdge(start, start + i);
-		//		}
-		//		subgraphs.push_back(star);
-		//	}
-		//}
+	//for (int starSize = 3; starSize < 8; ++starSize) {
+	//	for (int start = 0; start <= numQubits - starSize; ++start) {
+	//		Graph<> star{ numQubits };
+	//		for (int i = 0; i < starSize; ++i) {
+	//			star.addEdge(start, start + i);
+	//		}
+	//		subgraphs.push_back(star);
+	//	}
+	//}
+
+	//std::ranges::rotate(subgraphs, subgraphs.begin() + 128);
+	//for (int i = 128; i < subgraphs.size(); ++i) {
+	//	println("{}", subgraphs[i-128].getAdjacencyMatrix());
+	//}
+
+	
+
+	// A checkpoint of an interrupted run also fixes the seed so that the same graphs are sampled
+	const auto checkpointFile = checkpointFilename(outfilename);
+	std::optional<GrouperCheckpoint> checkpoint;
+	if (config.resume) {
+		if (std::filesystem::exists(checkpointFile)) {
+			checkpoint = readCheckpoint(checkpointFile, hamiltonian);
+			println("Resuming from checkpoint {}", checkpointFile);
+		}
+		else {
+			println("No checkpoint {} found, starting from scratch", checkpointFile);
+		}
+	}
+
+	const uint64_t seed = checkpoint ? checkpoint->seed : config.seed == 0 ? std::random_device{}() : config.seed;
+	//decltype(subgraphs) selectedGraphs;
+	//std::sample(subgraphs.begin(), subgraphs.end(), std::back_inserter(selectedGraphs), config.numGraphs, randomGenerator);
+	std::vector<Graph<>> selectedGraphs;
+
+	const auto prior = getGraphPrior(config, numQubits, shared);
+
+	if (!config.variableGraph) {
+		selectedGraphs = selectGraphs(config, connectivity, prior, seed, shared);
+		println("Running pauli grouper with {} Paulis and {} Graphs on {} qubits", hamiltonian.operators.size(), selectedGraphs.size(), numQubits);
+	}
+	else {
+		println("Running pauli grouper with {} Paulis on {} qubits, graphs are chosen by the solver", hamiltonian.operators.size(), numQubits);
+	}
+	println("Random seed: {}\n", seed);
+	std::vector<size_t> graphsEvaluated;
+	GrouperOptions options{
+		.numThreads = static_cast<int>(config.numThreads),
+		.collectionSolver = config.collectionSolver,
+		.mipTimeLimit = config.mipTimeLimit,
+		.mipWeighted = config.mipWeighted,
+		.incrementalConstraints = config.incrementalConstraints,
+		.insertionBlockSize = static_cast<int>(config.insertionBlockSize),
+		.speculativeInsertion = config.speculativeInsertion,
+		.timeBudget = config.timeBudget,
+		.numMainPaulis = static_cast<int>(config.numMainPaulis),
+		.graphsEvaluated = &graphsEvaluated,
+		.graphsPerIteration = static_cast<int>(config.graphsPerIteration),
+		.seed = seed,
+		.tailThreshold = config.tailWeightFraction > 0 ? std::max(config.tailThreshold, tailThresholdForWeightFraction(hamiltonian, config.tailWeightFraction)) : config.tailThreshold,
+		.checkpointFile = config.checkpointInterval > 0 ? checkpointFile : "",
+		.checkpointInterval = config.checkpointInterval,
+		.resumeFrom = checkpoint ? &*checkpoint : nullptr,
+		.finders = &shared.finders[numQubits],
+		.collectionCache = shared.collectionCache ? &*shared.collectionCache : nullptr
+	};
+	std::optional<JsonFormatting::JsonLinesWriter> stream;
+	if (!config.streamOutfilename.empty()) {
+		stream.emplace(toAbsolutePath(config.streamOutfilename));
+		options.onCollection = [&stream](const CollectionWithGraph& collection) { stream->write(collection); };
+	}
+	if (options.tailThreshold > 0) println("Paulis with |coefficient| < {} are treated as tail terms\n", options.tailThreshold);
+	auto htGrouping = config.variableGraph
+		? applyPauliGrouperVariableGraph(hamiltonian, connectivity, static_cast<int>(config.maxEdgeCount), options)
+		: config.algorithm == GroupingAlgorithm::HTMerge
+		? applyQWCGroupMerging(hamiltonian, selectedGraphs, options)
+		: config.numProcesses > 1
+		? applyPauliGrouperSharded(hamiltonian, selectedGraphs, static_cast<int>(config.numProcesses), options)
+		: applyPauliGrouper2Multithread2(hamiltonian, selectedGraphs, options);
+	if (config.refinementTime > 0) {
+		println("Refining grouping for up to {}s", config.refinementTime);
+		htGrouping = refineGrouping(hamiltonian, htGrouping, config.refinementTime, options);
+	}
+	auto tpbGrouping = applyTPBGrouper(hamiltonian);
 
-		//std::ranges::rotate(subgraphs, subgraphs.begin() + 128);
-		//for (int i = 128; i < subgraphs.size(); ++i) {
-		//	println("{}", subgraphs[i-128].getAdjacencyMatrix());
-		//}
+	// The output prior starts from the input prior and is written once all runs are done
+	if (!config.graphPriorOutput.empty()) shared.outputPriors.try_emplace(numQubits, prior).first->second.addWins(htGrouping);
 
-		
+	//htGrouping.erase(htGrouping.begin(), htGrouping.begin() + 2);
+	//tpbGrouping.erase(tpbGrouping.begin(), tpbGrouping.begin() + 2);
 
-		const auto seed = config.seed == 0 ? std::random_device{}() : config.seed;
-		std::mt19937_64 randomGenerator{ seed };
-		//decltype(subgraphs) selectedGraphs;
-		//std::sample(subgraphs.begin(), subgraphs.end(), std::back_inserter(selectedGraphs), config.numGraphs, randomGenerator);
-		auto selectedGraphs = getRandomSubgraphs(connectivity, config.numGraphs, config.maxEdgeCount, randomGenerator);
+	auto R_hat_HT = estimated_shot_reduction(hamiltonian, htGrouping);
+	auto R_hat_tpb = estimated_shot_reduction(hamiltonian, tpbGrouping);
+	// Loss due to the tail terms, compared to the best placement of the tail for the same main groups
+	const auto R_hat_loss_bound = options.tailThreshold > 0 ? estimated_shot_reduction_bound(hamiltonian, htGrouping, options.tailThreshold) - R_hat_HT : 0.;
 
-		if (config.sortGraphsByEdgeCount) {
-			std::ranges::sort(selectedGraphs, std::less{}, &Graph<>::edgeCount);
+	const auto t1 = clock::now();
+	const auto timeInSeconds = std::chrono::duration_cast<std::chrono::seconds>(t1 - t0).count();
+
+	println("Found grouping into {} subsets, run time: {}s", htGrouping.size(), timeInSeconds);
+
+
+	std::ofstream file{ outfilename };
+	auto fileout = std::ostream_iterator<char>(file);
+
+	const JsonFormatting::MetaInfo metaInfo{ timeInSeconds, selectedGraphs.size(), seed, connectivity, graphsEvaluated, options.tailThreshold, R_hat_loss_bound };
+	JsonFormatting::printPauliCollections(fileout, htGrouping, metaInfo);
+	if (stream) stream->finish(htGrouping, metaInfo, R_hat_HT);
+	println("Estimated shot reduction\n R_hat_HT = {}\n R_hat_TPB = {}\n R_hat_HT/R_hat_TPB = {}", R_hat_HT, R_hat_tpb, R_hat_HT / R_hat_tpb);
+	if (options.tailThreshold > 0) println(" R_hat_HT loss due to tail terms <= {}", R_hat_loss_bound);
+
+	// The run is complete, its checkpoint must not be resumed (a checkpoint of another run is left alone)
+	if (config.checkpointInterval > 0 || config.resume) std::filesystem::remove(checkpointFile);
+	return { htGrouping.size(), selectedGraphs.size(), R_hat_HT };
+}
+
+
+/// @brief Run the jobs of the batch file one after another in this process, each with its own output file. The
+///        hamiltonian of the next job is read while the current one runs. A failing job does not stop the batch. 
+void runBatch(const Configuration& config, SharedSetup& shared) {
+	const auto jobs = readBatch(toAbsolutePath(config.batch), config);
+	println("Running batch {} with {} jobs\n", config.batch, jobs.size());
+	if (!config.streamOutfilename.empty()) println("streamOutfilename is ignored in batch mode\n");
+
+	auto prefetch = [](const BatchJob& job) {
+		return std::async(std::launch::async, [filename = toAbsolutePath(job.filename)] { return readHamiltonian(filename); });
+	};
+	auto next = prefetch(jobs.front());
+	size_t numFailed{};
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		const auto& job = jobs[i];
+		auto current = std::move(next);
+		if (i + 1 < jobs.size()) next = prefetch(jobs[i + 1]);
+		println("Job {} of {}: {} on {}, numGraphs = {}, seed = {}, output: {}\n", i + 1, jobs.size(), job.filename, job.connectivity, job.numGraphs, job.seed, job.outfilename);
+		try {
+			auto jobConfig = config;
+			jobConfig.filename = job.filename;
+			jobConfig.connectivity = job.connectivity;
+			jobConfig.numGraphs = job.numGraphs;
+			jobConfig.seed = job.seed;
+			jobConfig.outfilename = job.outfilename;
+			jobConfig.streamOutfilename.clear();
+			const auto hamiltonian = current.get();
+			// Worker processes must not be forked while the prefetching thread may hold locks
+			if (config.numProcesses > 1 && next.valid()) next.wait();
+			runGrouping(jobConfig, hamiltonian, shared);
 		}
+		catch (std::exception& e) {
+			++numFailed;
+			println("Job {} failed: {}", i + 1, e.what());
+		}
+		println("");
+	}
+	println("Batch finished, {} of {} jobs succeeded", jobs.size() - numFailed, jobs.size());
+}
 
-		println("Running pauli grouper with {} Paulis and {} Graphs on {} qubits", hamiltonian.operators.size(), selectedGraphs.size(), numQubits);
-		println("Random seed: {}\n", seed);
-		auto htGrouping = applyPauliGrouper2Multithread2(hamiltonian, selectedGraphs, config.numThreads);
-		auto tpbGrouping = applyPauliGrouper2Multithread2(hamiltonian, { Graph<>(numQubits) }, config.numThreads, false);
 
-		//htGrouping.erase(htGrouping.begin(), htGrouping.begin() + 2);
-		//tpbGrouping.erase(tpbGrouping.begin(), tpbGrouping.begin() + 2);
+std::string sweepSetting(int64_t numGraphs) {
+	return numGraphs == allGraphs ? "all" : std::to_string(numGraphs);
+}
 
-		auto R_hat_HT = estimated_shot_reduction(hamiltonian, htGrouping);
-		auto R_hat_tpb = estimated_shot_reduction(hamiltonian, tpbGrouping);
+std::string sweepSettings(const std::vector<int64_t>& numGraphsSweep) {
+	std::string result;
+	for (const auto numGraphs : numGraphsSweep) result += (result.empty() ? "" : ", ") + sweepSetting(numGraphs);
+	return result;
+}
 
-		const auto t1 = clock::now();
-		const auto timeInSeconds = std::chrono::duration_cast<std::chrono::seconds>(t1 - t0).count();
 
-		println("Found grouping into {} subsets, run time: {}s", htGrouping.size(), timeInSeconds);
+/// @brief Run the grouping once for each number of graphs of config.numGraphsSweep in increasing order. All runs use 
+///        the same seed, so each graph set is made of the first samples of the same random stream and contains the 
+///        smaller ones. Collections that a smaller run already built for a graph are reused. Each run writes 
+///        <outfilename stem>_<numGraphs>_subgraphs.json, and runtime and R_hat of all runs go to <outfilename stem>_sweep.csv. 
+void runSweep(const Configuration& config, SharedSetup& shared) {
+	using clock = std::chrono::steady_clock;
+	const auto hamiltonian = readHamiltonian(toAbsolutePath(config.filename));
+	auto sweepConfig = config;
+	if (sweepConfig.seed == 0) sweepConfig.seed = std::random_device{}();
+	shared.collectionCache.emplace();
+
+	const std::filesystem::path outfile{ config.outfilename };
+	auto withSuffix = [&](const std::string& suffix) { return (outfile.parent_path() / (outfile.stem().string() + suffix)).generic_string(); };
+	const auto csvFilename = withSuffix("_sweep.csv");
+	std::ofstream csv{ toAbsolutePath(csvFilename) };
+	if (!csv) throw std::runtime_error(std::format("Could not open file \"{}\"", csvFilename));
+	csv << "numGraphs,graphs,groups,runtime [seconds],R_hat,reused collections\n";
+
+	println("Sweeping over {} settings of numGraphs with seed {}\n", config.numGraphsSweep.size(), sweepConfig.seed);
+	for (const auto numGraphs : config.numGraphsSweep) {
+		const auto setting = sweepSetting(numGraphs);
+		sweepConfig.numGraphs = numGraphs;
+		// Nothing runs after the last setting, its results need not be kept
+		if (numGraphs == config.numGraphsSweep.back()) shared.collectionCache->setReadOnly(true);
+		sweepConfig.outfilename = withSuffix(std::format("_{}_subgraphs{}", setting, outfile.extension().string()));
+		println("Sweep: numGraphs = {}, output: {}\n", setting, sweepConfig.outfilename);
+
+		const auto hitsBefore = shared.collectionCache->numHits();
+		const auto t0 = clock::now();
+		const auto summary = runGrouping(sweepConfig, hamiltonian, shared);
+		const auto seconds = std::chrono::duration<double>(clock::now() - t0).count();
+		const auto reused = shared.collectionCache->numHits() - hitsBefore;
+		println("Reused {} collections of smaller runs\n", reused);
 
+		csv << std::format("{},{},{},{},{},{}\n", setting, summary.numGraphs, summary.numGroups, seconds, summary.R_hat, reused);
+		csv.flush();
+	}
+	println("Sweep finished, results in {}", csvFilename);
+}
 
-		std::ofstream file{ outfilename };
-		auto fileout = std::ostream_iterator<char>(file);
 
-		JsonFormatting::printPauliCollections(fileout, htGrouping, JsonFormatting::MetaInfo{ timeInSeconds, selectedGraphs.size(), seed, connectivity });
-		println("Estimated shot reduction\n R_hat_HT = {}\n R_hat_TPB = {}\n R_hat_HT/R_hat_TPB = {}", R_hat_HT, R_hat_tpb, R_hat_HT / R_hat_tpb);
+/// @brief Group the hamiltonian once for each point of the scan file config.scan (same Pauli strings, other 
+///        coefficients). All points use the same graphs and share one CollectionCache, so each feasibility check, 
+///        which does not depend on the coefficients, is solved once for all points. Points run concurrently with 
+///        numThreads split among them. Each point writes <outfilename stem>_<label>.json, and groups, runtime and 
+///        R_hat of all points go to <outfilename stem>_scan.csv. A failing point does not stop the scan. 
+void runScan(const Configuration& config, SharedSetup& shared) {
+	using clock = std::chrono::steady_clock;
+	const auto t0 = clock::now();
+	const auto hamiltonian = readHamiltonian(toAbsolutePath(config.filename));
+	const auto points = readScan(toAbsolutePath(config.scan), hamiltonian.operators.size());
+	const auto numQubits = hamiltonian.numQubits;
+	const auto connectivity = readConnectivity(toAbsolutePath(config.connectivity)).getGraph(numQubits);
+
+	const auto prior = getGraphPrior(config, numQubits, shared);
+	const uint64_t seed = config.seed == 0 ? std::random_device{}() : config.seed;
+	const auto graphs = selectGraphs(config, connectivity, prior, seed, shared);
+	shared.collectionCache.emplace();
+
+	const auto numWorkers = std::min(points.size(), static_cast<size_t>(config.numThreads));
+	// The first numThreads % numWorkers workers take one of the remaining threads each
+	const auto numThreads = static_cast<size_t>(config.numThreads);
+	auto threadsOfWorker = [&](size_t worker) { return static_cast<int>(numThreads / numWorkers + (worker < numThreads % numWorkers)); };
+	println("Scanning {} points with {} Paulis and {} graphs on {} qubits, {} at a time with {} to {} threads each", 
+		points.size(), hamiltonian.operators.size(), graphs.size(), numQubits, numWorkers, threadsOfWorker(numWorkers - 1), threadsOfWorker(0));
+	println("Random seed: {}\n", seed);
+	if (config.refinementTime > 0 || !config.streamOutfilename.empty() || !config.graphPriorOutput.empty())
+		println("refinementTime, streamOutfilename and graphPriorOutput are ignored in scan mode\n");
+
+	const std::filesystem::path outfile{ config.outfilename };
+	auto withSuffix = [&](const std::string& suffix) { return (outfile.parent_path() / (outfile.stem().string() + suffix)).generic_string(); };
+
+	struct PointResult {
+		size_t numGroups{};
+		double seconds{};
+		double R_hat{};
+		bool failed{};
+	};
+	std::vector<PointResult> results(points.size());
+	std::atomic_size_t nextPoint{};
+	std::mutex printMutex;
+
+	auto work = [&](std::vector<HTCircuitFinder>& finders, int threadsPerPoint) {
+		for (size_t p; (p = nextPoint++) < points.size();) {
+			const auto& point = points[p];
+			const auto pointStart = clock::now();
+			try {
+				auto pointHamiltonian = hamiltonian;
+				for (size_t term = 0; term < point.coefficients.size(); ++term) pointHamiltonian.operators[term].second = point.coefficients[term];
+
+				const GrouperOptions options{
+					.numThreads = threadsPerPoint,
+					.verbose = false,
+					.collectionSolver = config.collectionSolver,
+					.mipTimeLimit = config.mipTimeLimit,
+					.mipWeighted = config.mipWeighted,
+					.incrementalConstraints = config.incrementalConstraints,
+					.insertionBlockSize = static_cast<int>(config.insertionBlockSize),
+					.speculativeInsertion = config.speculativeInsertion,
+					.timeBudget = config.timeBudget,
+					.numMainPaulis = static_cast<int>(config.numMainPaulis),
+					.graphsPerIteration = static_cast<int>(config.graphsPerIteration),
+					.seed = seed,
+					.tailThreshold = config.tailWeightFraction > 0 ? std::max(config.tailThreshold, tailThresholdForWeightFraction(pointHamiltonian, config.tailWeightFraction)) : config.tailThreshold,
+					.finders = &finders,
+					.collectionCache = &*shared.collectionCache
+				};
+				const auto grouping = applyPauliGrouper2Multithread2(pointHamiltonian, graphs, options);
+				const auto R_hat = estimated_shot_reduction(pointHamiltonian, grouping);
+				const auto R_hat_loss_bound = options.tailThreshold > 0 ? estimated_shot_reduction_bound(pointHamiltonian, grouping, options.tailThreshold) - R_hat : 0.;
+				const auto seconds = std::chrono::duration<double>(clock::now() - pointStart).count();
+
+				std::ofstream file{ toAbsolutePath(withSuffix("_" + point.label + outfile.extension().string())) };
+				const JsonFormatting::MetaInfo metaInfo{ std::llround(seconds), graphs.size(), seed, connectivity, {}, options.tailThreshold, R_hat_loss_bound };
+				JsonFormatting::printPauliCollections(std::ostream_iterator<char>(file), grouping, metaInfo);
+
+				results[p] = { grouping.size(), seconds, R_hat };
+				std::scoped_lock lock{ printMutex };
+				println("Point {} ({} of {}): {} groups, R_hat = {}, {:.2f}s", point.label, p + 1, points.size(), grouping.size(), R_hat, seconds);
+			}
+			catch (std::exception& e) {
+				results[p].failed = true;
+				std::scoped_lock lock{ printMutex };
+				println("Point {} failed: {}", point.label, e.what());
+			}
+		}
+	};
+
+	// Each worker keeps its solver instances for all of its points
+	std::vector<std::vector<HTCircuitFinder>> workerFinders(numWorkers);
+	{
+		std::vector<std::jthread> workers;
+		for (size_t worker = 0; worker < numWorkers; ++worker) workers.emplace_back(work, std::ref(workerFinders[worker]), threadsOfWorker(worker));
+	}
+
+	const auto csvFilename = withSuffix("_scan.csv");
+	std::ofstream csv{ toAbsolutePath(csvFilename) };
+	if (!csv) throw std::runtime_error(std::format("Could not open file \"{}\"", csvFilename));
+	csv << "label,groups,runtime [seconds],R_hat\n";
+	for (size_t p = 0; p < points.size(); ++p) {
+		if (results[p].failed) csv << std::format("{},,,\n", points[p].label);
+		else csv << std::format("{},{},{},{}\n", points[p].label, results[p].numGroups, results[p].seconds, results[p].R_hat);
+	}
+
+	const auto seconds = std::chrono::duration<double>(clock::now() - t0).count();
+	println("\nScan finished in {:.2f}s, {} of {} points succeeded, {} feasibility checks answered from the cache, results in {}", seconds,
+		std::ranges::count(results, false, &PointResult::failed), points.size(), shared.collectionCache->numFeasibilityHits(), csvFilename);
+}
+
+
+int main() {
+	try {
+
+		Configuration config = readConfig(DATA_PATH "config.txt");
+		println(R"(Configuration:
+  filename = {}
+  outfilename = {}
+  streamOutfilename = {}
+  connectivity = {}
+  numThreads = {}
+  numProcesses = {}
+  maxEdgeCount = {}
+  numGraphs = {}
+  maxComponentSize = {}
+  componentShape = {}
+  sortGraphsByEdgeCount = {}
+  sortGraphsByGrayCode = {}
+  incrementalConstraints = {}
+  insertionBlockSize = {}
+  speculativeInsertion = {}
+  collectionSolver = {}
+  graphSelection = {}
+  algorithm = {}
+  refinementTime = {}s
+  timeBudget = {}
+  numMainPaulis = {}
+  graphsPerIteration = {}
+  graphPrior = {}
+  graphPriorOutput = {}
+  tailThreshold = {}
+  tailWeightFraction = {}
+  checkpointInterval = {}
+  resume = {}
+  batch = {}
+  numGraphsSweep = {}
+  scan = {}
+)", config.filename, config.outfilename, config.streamOutfilename.empty() ? "none" : config.streamOutfilename, config.connectivity, config.numThreads, config.numProcesses, config.maxEdgeCount, config.numGraphs,
+			config.maxComponentSize > 0 ? std::to_string(config.maxComponentSize) : "unbounded",
+			config.componentShape == ComponentShape::Path ? "path" : config.componentShape == ComponentShape::Star ? "star" : "any", config.sortGraphsByEdgeCount,
+			config.sortGraphsByGrayCode, config.incrementalConstraints, config.insertionBlockSize, config.speculativeInsertion,
+			config.collectionSolver == CollectionSolver::Mip ? std::format("mip ({}, {}s time limit)", config.mipWeighted ? "weight" : "count", config.mipTimeLimit) : "greedy",
+			config.variableGraph ? "variable" : "sampled",
+			config.algorithm == GroupingAlgorithm::HT ? "ht" : config.algorithm == GroupingAlgorithm::HTMerge ? "htMerge" : std::format("{} ({} commutation)",
+				config.algorithm == GroupingAlgorithm::SortedInsertion ? "sortedInsertion" : config.algorithm == GroupingAlgorithm::DSatur ? "dsatur" : "largestFirst",
+				config.commutation == Commutation::QubitWise ? "qubitwise" : "general"),
+			config.refinementTime, config.timeBudget > 0 ? std::format("{}s", config.timeBudget) : "none", config.numMainPaulis,
+			config.graphsPerIteration > 0 ? std::format("{} (adaptive)", config.graphsPerIteration) : "all",
+			config.graphPrior.empty() ? "none" : std::format("{} ({})", config.graphPrior, config.graphPriorExclusive ? "exclusive" : "first"),
+			config.graphPriorOutput.empty() ? "none" : config.graphPriorOutput, config.tailThreshold, config.tailWeightFraction,
+			config.checkpointInterval > 0 ? std::format("{}s", config.checkpointInterval) : "none", config.resume,
+			config.batch.empty() ? "none" : config.batch,
+			config.numGraphsSweep.empty() ? "none" : sweepSettings(config.numGraphsSweep), config.scan.empty() ? "none" : config.scan);
+
+
+		SharedSetup shared;
+		if (!config.batch.empty()) {
+			runBatch(config, shared);
+		}
+		else if (!config.numGraphsSweep.empty()) {
+			runSweep(config, shared);
+		}
+		else if (!config.scan.empty()) {
+			runScan(config, shared);
+		}
+		else {
+			runGrouping(config, readHamiltonian(toAbsolutePath(config.filename)), shared);
+		}
+		writeGraphPriors(config, shared);
 	}
 	catch (ConfigReadError& e) {
 		println("ConfigReadError: {}", e.what());
@@ -146,6 +563,12 @@ int main() {
 	catch (ConnectivityError& e) {
 		println("ConnectivityError: {}", e.what());
 	}
+	catch (GraphPriorError& e) {
+		println("GraphPriorError: {}", e.what());
+	}
+	catch (CheckpointError& e) {
+		println("CheckpointError: {}", e.what());
+	}
 	catch (std::exception& e) {
 		println("{}", e.what());
 	}
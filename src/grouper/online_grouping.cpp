@@ -0,0 +1,221 @@
+
+#include "online_grouping.h"
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+
+
+using namespace Q;
+
+
+OnlineGrouping::OnlineGrouping(const Hamiltonian& hamiltonian, std::vector<Graph<>> graphs, GrouperOptions options, double regroupThreshold)
+	: numQubits(hamiltonian.numQubits), graphs(std::move(graphs)), options(std::move(options)), regroupThreshold(regroupThreshold) {
+
+	// Repeated Paulis are merged into one term
+	for (const auto& [pauli, coefficient] : hamiltonian.operators) {
+		const auto term = normalized(pauli, coefficient);
+		terms.try_emplace(keyOf(term.pauli), Term{ term.pauli }).first->second.coefficient += term.coefficient;
+	}
+	regroup();
+}
+
+
+bool OnlineGrouping::insert(const Pauli& pauli, double coefficient) {
+	insertTerm(pauli, coefficient);
+	return checkThreshold();
+}
+
+
+bool OnlineGrouping::remove(const Pauli& pauli) {
+	removeTerm(pauli);
+	return checkThreshold();
+}
+
+
+bool OnlineGrouping::update(const std::vector<std::pair<Pauli, double>>& insertions, const std::vector<Pauli>& removals) {
+	for (const auto& pauli : removals) removeTerm(pauli);
+	for (const auto& [pauli, coefficient] : insertions) insertTerm(pauli, coefficient);
+	return checkThreshold();
+}
+
+
+void OnlineGrouping::regroup() {
+	grouping = applyPauliGrouper2Multithread2(getHamiltonian(), graphs, options);
+	rebuild();
+	referenceRHat = getRHat();
+	++regroups;
+}
+
+
+Hamiltonian OnlineGrouping::getHamiltonian() const {
+	Hamiltonian hamiltonian{ {}, numQubits };
+	hamiltonian.operators.reserve(terms.size());
+	for (const auto& [key, term] : terms) hamiltonian.operators.emplace_back(term.pauli, term.coefficient);
+	return hamiltonian;
+}
+
+
+double OnlineGrouping::getRHat() const {
+	double denominator{};
+	for (auto squaredWeight : squaredWeights) denominator += std::sqrt(std::max(squaredWeight, 0.));
+	if (denominator == 0) return 0.;
+	return absoluteWeight * absoluteWeight / (denominator * denominator);
+}
+
+
+OnlineGrouping::Term OnlineGrouping::normalized(const Pauli& pauli, double coefficient) const {
+	const auto phase = pauli.getPhase();
+	if (!phase.isPlusMinus()) throw std::invalid_argument(std::format("The Pauli {} has an imaginary phase", pauli));
+	return { Pauli::FromBitstrings(numQubits, pauli.getXString(), pauli.getZString()), phase == BinaryPhase{ 2 } ? -coefficient : coefficient };
+}
+
+
+double OnlineGrouping::weightOf(const Term& term) const {
+	// The identity does not need to be measured (as in estimated_shot_reduction())
+	return term.pauli == Pauli::Identity(numQubits) ? 0. : std::abs(term.coefficient);
+}
+
+
+void OnlineGrouping::insertTerm(const Pauli& pauli, double coefficient) {
+	const auto newTerm = normalized(pauli, coefficient);
+	if (const auto it = terms.find(keyOf(newTerm.pauli)); it != terms.end()) {
+		auto& term = it->second;
+		const auto oldWeight = weightOf(term);
+		term.coefficient = newTerm.coefficient;
+		const auto weight = weightOf(term);
+		squaredWeights[term.collection] += weight * weight - oldWeight * oldWeight;
+		absoluteWeight += weight - oldWeight;
+		return;
+	}
+	auto& term = terms.emplace(keyOf(newTerm.pauli), newTerm).first->second;
+	addToCollection(term, findCollection(term.pauli, grouping.size()));
+}
+
+
+// By value: the Pauli may be a reference into the collection it is erased from
+void OnlineGrouping::removeTerm(Pauli pauli) {
+	const auto it = terms.find(keyOf(pauli));
+	if (it == terms.end()) throw std::invalid_argument(std::format("{} is not a term of the grouping", pauli));
+
+	const auto c = it->second.collection;
+	const auto weight = weightOf(it->second);
+	squaredWeights[c] -= weight * weight;
+	absoluteWeight -= weight;
+	terms.erase(it);
+
+	// Terms are identified without their phase (the stored Pauli has none)
+	auto& collection = grouping[c];
+	std::erase_if(collection.paulis, [key = keyOf(pauli)](const Pauli& p) { return keyOf(p) == key; });
+	if (collection.paulis.empty()) {
+		eraseCollection(c);
+		return;
+	}
+	// A qubit-wise collection may accept more Paulis without the removed one
+	if (checks[c].isQubitWise()) {
+		checks[c] = DiagonalizationCheck{ collection, numQubits };
+		collection.singleQubitLayer = computeQubitWiseLayer(collection.paulis, numQubits);
+	}
+	dissolve(c);
+}
+
+
+void OnlineGrouping::addToCollection(Term& term, size_t c) {
+	if (c == grouping.size()) {
+		grouping.push_back({ {}, Graph<>{ numQubits } });
+		checks.emplace_back(grouping.back(), numQubits);
+		squaredWeights.push_back(0.);
+	}
+	auto& collection = grouping[c];
+	collection.paulis.push_back(term.pauli);
+	checks[c].add(term.pauli);
+	if (checks[c].isQubitWise()) collection.singleQubitLayer = computeQubitWiseLayer(collection.paulis, numQubits);
+
+	term.collection = c;
+	const auto weight = weightOf(term);
+	squaredWeights[c] += weight * weight;
+	absoluteWeight += weight;
+}
+
+
+void OnlineGrouping::dissolve(size_t c) {
+	// Merging two collections never lowers R_hat (√a + √b >= √(a + b)), but each Pauli needs a target. Qubit-wise
+	// targets accept fewer Paulis with every Pauli they take, so their checks are extended while targets are chosen.
+	std::map<size_t, DiagonalizationCheck> extended;
+	auto checkOf = [&](size_t t) -> const DiagonalizationCheck& {
+		const auto it = extended.find(t);
+		return it != extended.end() ? it->second : checks[t];
+	};
+
+	std::vector<size_t> targets;
+	for (const auto& pauli : grouping[c].paulis) {
+		size_t target = grouping.size();
+		for (size_t t = 0; t < grouping.size(); ++t) {
+			if (t == c || !checkOf(t).diagonalizes(pauli)) continue;
+			if (target == grouping.size() || squaredWeights[t] > squaredWeights[target]) target = t;
+		}
+		if (target == grouping.size()) return;
+		if (checks[target].isQubitWise()) extended.try_emplace(target, checks[target]).first->second.add(pauli);
+		targets.push_back(target);
+	}
+
+	const auto paulis = std::move(grouping[c].paulis);
+	grouping[c].paulis.clear();
+	for (size_t i = 0; i < paulis.size(); ++i) {
+		auto& term = terms.at(keyOf(paulis[i]));
+		const auto weight = weightOf(term);
+		squaredWeights[c] -= weight * weight;
+		absoluteWeight -= weight;
+		addToCollection(term, targets[i]);
+	}
+	eraseCollection(c);
+}
+
+
+void OnlineGrouping::eraseCollection(size_t c) {
+	const auto last = grouping.size() - 1;
+	if (c != last) {
+		grouping[c] = std::move(grouping[last]);
+		checks[c] = std::move(checks[last]);
+		squaredWeights[c] = squaredWeights[last];
+		for (const auto& pauli : grouping[c].paulis) terms.at(keyOf(pauli)).collection = c;
+	}
+	grouping.pop_back();
+	checks.pop_back();
+	squaredWeights.pop_back();
+}
+
+
+size_t OnlineGrouping::findCollection(const Pauli& pauli, size_t exclude) const {
+	// Among the collections that can take the Pauli, the one with the largest squared weight loses the least R_hat
+	size_t best = grouping.size();
+	for (size_t c = 0; c < grouping.size(); ++c) {
+		if (c == exclude || !checks[c].diagonalizes(pauli)) continue;
+		if (best == grouping.size() || squaredWeights[c] > squaredWeights[best]) best = c;
+	}
+	return best;
+}
+
+
+bool OnlineGrouping::checkThreshold() {
+	if (getRHat() >= (1 - regroupThreshold) * referenceRHat) return false;
+	regroup();
+	return true;
+}
+
+
+void OnlineGrouping::rebuild() {
+	checks.clear();
+	squaredWeights.assign(grouping.size(), 0.);
+	absoluteWeight = 0.;
+	for (size_t c = 0; c < grouping.size(); ++c) {
+		checks.emplace_back(grouping[c], numQubits);
+		for (const auto& pauli : grouping[c].paulis) {
+			auto& term = terms.at(keyOf(pauli));
+			term.collection = c;
+			const auto weight = weightOf(term);
+			squaredWeights[c] += weight * weight;
+			absoluteWeight += weight;
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "pauli_grouper.h"
+#include <map>
+
+
+namespace Q {
+
+	/// @brief Grouping of a hamiltonian that is kept up to date while terms are added and removed (f.e. between the
+	///        iterations of an adaptive VQE) without running the grouper each time.
+	///
+	///        A new term joins the existing collection with the largest summed squared coefficients whose circuit
+	///        already diagonalizes it (see DiagonalizationCheck), which costs the least R_hat. If there is none, it
+	///        opens a new qubit-wise collection. A removed term is dropped from its collection, which stays measurable
+	///        with the same circuit. The collection is then dissolved if all of its remaining terms fit into other
+	///        collections, which never lowers R_hat.
+	///
+	///        Terms are stored without phase: a phase of -1 is folded into the coefficient and Paulis with phase ±i
+	///        are rejected (std::invalid_argument). Paulis that only differ in their phase are the same term.
+	///
+	///        R_hat is updated from per-collection sums in O(number of collections). If it drops below
+	///        (1 - regroupThreshold) times its value after the last full grouping, the hamiltonian is grouped again
+	///        with applyPauliGrouper2Multithread2(). Single updates only need bit checks and no solves.
+	class OnlineGrouping {
+	public:
+		/// @param hamiltonian      Initial terms, grouped right away
+		/// @param graphs           Allowed graphs for full groupings
+		/// @param options          Options for full groupings
+		/// @param regroupThreshold Relative loss in R_hat that triggers a full grouping
+		OnlineGrouping(const Hamiltonian& hamiltonian, std::vector<Graph<>> graphs, GrouperOptions options, double regroupThreshold = 0.05);
+
+		/// @brief Add a term, or change its coefficient if the Pauli is already a term.
+		/// @return Whether a full grouping was triggered
+		bool insert(const Pauli& pauli, double coefficient);
+
+		/// @brief Remove a term. Throws std::invalid_argument if the Pauli is not a term.
+		/// @return Whether a full grouping was triggered
+		bool remove(const Pauli& pauli);
+
+		/// @brief Apply several insertions and removals and check the threshold once at the end.
+		/// @return Whether a full grouping was triggered
+		bool update(const std::vector<std::pair<Pauli, double>>& insertions, const std::vector<Pauli>& removals);
+
+		/// @brief Group the current terms from scratch.
+		void regroup();
+
+		const std::vector<CollectionWithGraph>& getGrouping() const { return grouping; }
+		Hamiltonian getHamiltonian() const;
+		size_t numTerms() const { return terms.size(); }
+
+		/// @brief Estimated shot reduction of the current grouping (see estimated_shot_reduction()).
+		double getRHat() const;
+		/// @brief Estimated shot reduction right after the last full grouping
+		double getReferenceRHat() const { return referenceRHat; }
+		/// @brief Number of full groupings, including the initial one
+		size_t numRegroups() const { return regroups; }
+
+	private:
+		using Key = std::pair<Pauli::Bitstring, Pauli::Bitstring>;
+
+		struct Term {
+			Pauli pauli;
+			double coefficient{};
+			size_t collection{};
+		};
+
+		static Key keyOf(const Pauli& pauli) { return { pauli.getXString(), pauli.getZString() }; }
+		/// @brief Term with the phase of @p pauli (±1, otherwise std::invalid_argument) folded into the coefficient
+		Term normalized(const Pauli& pauli, double coefficient) const;
+		double weightOf(const Term& term) const;
+
+		void insertTerm(const Pauli& pauli, double coefficient);
+		void removeTerm(Pauli pauli);
+		/// @brief Add a term to collection @p c (or to a new collection if @p c == grouping.size()).
+		void addToCollection(Term& term, size_t c);
+		/// @brief Move the terms of collection @p c into other collections if all of them fit.
+		void dissolve(size_t c);
+		/// @brief Remove the empty collection @p c (the last collection takes its place).
+		void eraseCollection(size_t c);
+		/// @brief Best other collection whose circuit diagonalizes the Pauli or grouping.size() if there is none.
+		size_t findCollection(const Pauli& pauli, size_t exclude) const;
+		bool checkThreshold();
+		void rebuild();
+
+		int numQubits{};
+		std::vector<Graph<>> graphs;
+		GrouperOptions options;
+		double regroupThreshold{};
+
+		std::map<Key, Term> terms;
+		std::vector<CollectionWithGraph> grouping;
+		std::vector<DiagonalizationCheck> checks;
+		// Summed squared coefficients of each collection and summed absolute coefficients of all terms (identity excluded)
+		std::vector<double> squaredWeights;
+		double absoluteWeight{};
+		double referenceRHat{};
+		size_t regroups{};
+	};
+
+}
@@ -1,9 +1,15 @@
 
 #include "pauli_grouper.h"
 #include "find_ht_circuit.h"
+#include "checkpoint.h"
 #include <ranges>
 #include <thread>
 #include <algorithm>
+#include <span>
+#include <numeric>
+#include <mutex>
+#include <random>
+#include <sstream>
 
 
 using namespace Q;
@@ -54,6 +60,26 @@ void Q::computeSingleQubitLayer(std::vector<CollectionWithGraph>& grouping) {
 
 }
 
+std::vector<BinaryCliffordGate> Q::computeQubitWiseLayer(const std::vector<Pauli>& collection, int numQubits) {
+	// All Paulis in a qubit-wise commuting collection share the same letter on each qubit where any of them acts 
+	// non-trivially, so the union of the x and z strings gives that letter. 
+	Pauli::Bitstring xString{};
+	Pauli::Bitstring zString{};
+	for (const auto& pauli : collection) {
+		xString |= pauli.getXString();
+		zString |= pauli.getZString();
+	}
+
+	// Rotate each letter to X (z' = 0 for the edgeless graph): X -> I, Z -> H, Y -> S
+	std::vector<BinaryCliffordGate> layer;
+	for (int qubit = 0; qubit < numQubits; ++qubit) {
+		const bool x = (xString >> qubit) & 1;
+		const bool z = (zString >> qubit) & 1;
+		layer.push_back(z ? (x ? BinaryCliffordGates::S : BinaryCliffordGates::H) : BinaryCliffordGates::I);
+	}
+	return layer;
+}
+
 bool Q::commutesWithAll(const std::vector<Pauli>& collection, const Pauli& pauli) {
 	for (const auto& p : collection) {
 		if (commutator(p, pauli) == 1) return false;
@@ -118,6 +144,28 @@ namespace Q {
 		}
 		return true;
 	}
+
+	/// @brief Necessary conditions for adding a Pauli to a collection on a graph that need no solver: the Pauli 
+	///        commutes with the collection, also locally on each connected component. 
+	bool passesCheapChecks(const std::vector<Pauli>& collection, const Pauli& pauli, const GraphRepr& graph) {
+		return commutesWithAll(collection, pauli) && std::ranges::all_of(graph.connectedComponentSupportVectors, [&](auto supportVector) {
+			return locallyCommutesWithAll(collection, pauli, supportVector); });
+	}
+
+	/// @brief Sequential greedy insertion: each candidate that passes the cheap checks is appended to the collection 
+	///        and kept if isMeasurable(collection) holds. Stops before the next solve once stop() returns true. 
+	template<class Candidates, class IsMeasurable, class Stop>
+	void insertSequentially(std::vector<Pauli>& collection, Candidates&& candidates, const GraphRepr& graph, IsMeasurable&& isMeasurable, Stop&& stop) {
+		for (const auto& pauli : candidates) {
+			if (!passesCheapChecks(collection, pauli, graph)) continue;
+			if (stop()) break;
+
+			collection.push_back(pauli);
+			if (!isMeasurable(collection)) {
+				collection.pop_back();
+			}
+		}
+	}
 }
 
 
@@ -326,20 +374,692 @@ std::vector<CollectionWithGraph> Q::applyPauliGrouper2Multithread(const Hamilton
 
 
 
+Q::CollectionCache::Fingerprint Q::CollectionCache::fingerprint(std::span<const std::pair<Pauli, double>> terms) {
+	// Two independent 64 bit hashes of the sequence of bit strings (splitmix64 finalizer)
+	auto mix = [](uint64_t value) {
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+		return value ^ (value >> 31);
+	};
+	Fingerprint result{ 0x9e3779b97f4a7c15, 0xc2b2ae3d27d4eb4f };
+	for (const auto& [pauli, coefficient] : terms) {
+		result[0] = mix(result[0] ^ mix(pauli.getXString())) + pauli.getZString();
+		result[1] = mix(result[1] + mix(pauli.getZString() ^ 0x165667b19e3779f9)) ^ pauli.getXString();
+	}
+	result[0] = mix(result[0] ^ terms.size());
+	return result;
+}
+
+Q::CollectionCache::Fingerprint Q::CollectionCache::setFingerprint(std::span<const Pauli> paulis) {
+	auto mix = [](uint64_t value) {
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+		return value ^ (value >> 31);
+	};
+	// Sums of per-Pauli hashes do not depend on the order
+	Fingerprint result{ paulis.size(), ~uint64_t{} ^ paulis.size() };
+	for (const auto& pauli : paulis) {
+		result[0] += mix(pauli.getXString() ^ mix(pauli.getZString()));
+		result[1] += mix(pauli.getZString() + mix(pauli.getXString() ^ 0x9e3779b97f4a7c15));
+	}
+	return result;
+}
+
+std::optional<std::optional<std::vector<Pauli>>> Q::CollectionCache::find(const Graph<>& graph, const Fingerprint& terms) const {
+	++lookups;
+	std::shared_lock lock{ mutex };
+	const auto entry = entries.find({ graph.getEdges(), terms });
+	if (entry == entries.end()) return std::nullopt;
+	++hits;
+	return entry->second;
+}
+
+template<class Value>
+void Q::CollectionCache::insertBounded(std::map<Key, Value>& table, std::deque<typename std::map<Key, Value>::iterator>& order, Key key, Value value) {
+	if (readOnly || maxEntries == 0) return;
+	std::unique_lock lock{ mutex };
+	const auto [entry, inserted] = table.try_emplace(std::move(key), std::move(value));
+	if (!inserted) return;
+	order.push_back(entry);
+	if (order.size() > maxEntries) {
+		table.erase(order.front());
+		order.pop_front();
+	}
+}
+
+void Q::CollectionCache::insert(const Graph<>& graph, const Fingerprint& terms, std::optional<std::vector<Pauli>> collection) {
+	insertBounded(entries, entryOrder, { graph.getEdges(), terms }, std::move(collection));
+}
+
+std::optional<bool> Q::CollectionCache::findFeasibility(const Graph<>& graph, const Fingerprint& paulis) const {
+	std::shared_lock lock{ mutex };
+	const auto entry = feasibility.find({ graph.getEdges(), paulis });
+	if (entry == feasibility.end()) return std::nullopt;
+	++feasibilityHits;
+	return entry->second;
+}
+
+void Q::CollectionCache::insertFeasibility(const Graph<>& graph, const Fingerprint& paulis, bool measurable) {
+	insertBounded(feasibility, feasibilityOrder, { graph.getEdges(), paulis }, measurable);
+}
+
+size_t Q::CollectionCache::size() const {
+	std::shared_lock lock{ mutex };
+	return entries.size();
+}
+
+
 std::vector<CollectionWithGraph> Q::applyPauliGrouper2Multithread2(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, int numThreads, bool verbose) {
-	const auto numGraphsPerThread = static_cast<size_t>(std::ceil(static_cast<float>(graphs.size()) / static_cast<float>(numThreads)));
-	std::vector<HTCircuitFinder> finders;
-	for (int i = 0; i < numThreads; ++i) finders.emplace_back(hamiltonian.numQubits);
+	return applyPauliGrouper2Multithread2(hamiltonian, graphs, GrouperOptions{ .numThreads = numThreads, .verbose = verbose });
+}
+
+
+std::vector<CollectionWithGraph> Q::applyPauliGrouper2Multithread2(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, const GrouperOptions& options) {
+	using clock = std::chrono::steady_clock;
+	const auto numThreads = options.numThreads;
+	const auto verbose = options.verbose;
+	std::vector<HTCircuitFinder> ownFinders;
+	auto& finders = options.finders ? *options.finders : ownFinders;
+	while (finders.size() < static_cast<size_t>(numThreads)) finders.emplace_back(hamiltonian.numQubits);
+	// Whole-collection solves depend on time limits and the best score so far, only greedy results are reused
+	CollectionCache* const cache = options.collectionSolver == CollectionSolver::Greedy ? options.collectionCache : nullptr;
 
 	auto paulis = hamiltonian.operators;
 	// Sort by magnitude in descending order 
 	std::ranges::sort(paulis, [](const auto& a, const auto& b) {return std::abs(a.second) > std::abs(b.second); });
 
+	// Tail terms are left out of the search and inserted at the end
+	const auto firstTailTerm = std::ranges::find_if(paulis, [&](const auto& a) { return std::abs(a.second) < options.tailThreshold; });
+	const std::vector<std::pair<Pauli, double>> tail(firstTailTerm, paulis.end());
+	paulis.erase(firstTailTerm, paulis.end());
+	// Without any measured term above the threshold, the grouping would be TPB and the R_hat loss bound meaningless
+	if (!tail.empty() && std::ranges::none_of(paulis, [&](const auto& a) { return a.first != Pauli::Identity(hamiltonian.numQubits); }))
+		throw std::invalid_argument(std::format("All terms are below the tail threshold {}", options.tailThreshold));
+
 	std::vector<CollectionWithGraph> collections;
 	std::vector<GraphRepr> graphReprs;
 
 	for (const auto& graph : graphs) graphReprs.emplace_back(graph);
 
+	// Collections are compared by size, or by their coefficient weight for the weighted whole-collection solve. 
+	const bool weighted = options.collectionSolver == CollectionSolver::Mip && options.mipWeighted;
+	auto weightOf = [weighted](double coefficient) { return weighted ? std::abs(coefficient) : 1.; };
+
+	// With a time budget, the number of graphs per iteration is planned from the measured time per 
+	// (main Pauli, graph) pair and the size of the last collection as estimate for the remaining iterations. 
+	const bool timed = options.timeBudget > 0;
+	const auto runStart = clock::now();
+	const double previousSeconds = options.resumeFrom ? options.resumeFrom->elapsedSeconds : 0.;
+	const auto deadline = runStart + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(options.timeBudget - previousSeconds));
+	double secondsPerUnit{};
+	size_t lastCollectionSize{ 1 };
+
+	// Adaptive graph selection: a bandit over the graphs where the reward of an evaluation is the collection size 
+	// relative to the best collection of the iteration. 
+	const bool adaptive = options.graphsPerIteration > 0 && static_cast<size_t>(options.graphsPerIteration) < graphs.size();
+	std::vector<GraphStatistics> graphStatistics(graphs.size());
+	std::mt19937_64 randomGenerator{ options.seed };
+	size_t numGraphEvaluations{};
+	size_t numExhaustiveGraphEvaluations{};
+	size_t numPrunedUnits{};
+
+	const auto setupHash = options.resumeFrom || !options.checkpointFile.empty() ? checkpointSetupHash(hamiltonian, graphs, options) : uint64_t{};
+	if (const auto* checkpoint = options.resumeFrom) {
+		if (checkpoint->numGraphs != graphs.size()) throw CheckpointError(std::format("The checkpoint is for a run with {} graphs, not {}", checkpoint->numGraphs, graphs.size()));
+		if (checkpoint->setupHash != setupHash) throw CheckpointError("The checkpoint is for a run with other graphs, coefficients or options");
+		collections = checkpoint->collections;
+		if (options.onCollection) std::ranges::for_each(collections, options.onCollection);
+		paulis.clear();
+		for (auto index : checkpoint->remaining) paulis.push_back(hamiltonian.operators[index]);
+		std::istringstream{ checkpoint->randomGeneratorState } >> randomGenerator;
+		if (checkpoint->graphStatistics.size() == graphs.size()) graphStatistics = checkpoint->graphStatistics;
+		numGraphEvaluations = checkpoint->numGraphEvaluations;
+		numExhaustiveGraphEvaluations = checkpoint->numExhaustiveGraphEvaluations;
+		numPrunedUnits = checkpoint->numPrunedUnits;
+		if (options.graphsEvaluated) *options.graphsEvaluated = checkpoint->graphsEvaluated;
+		secondsPerUnit = checkpoint->secondsPerUnit;
+		lastCollectionSize = checkpoint->lastCollectionSize;
+		if (verbose) println("Resuming from checkpoint with {} groups and {} Paulis remaining\n", collections.size(), paulis.size());
+	}
+	auto lastCheckpoint = runStart;
+
+	auto saveCheckpoint = [&] {
+		GrouperCheckpoint checkpoint{
+			.seed = options.seed,
+			.numQubits = hamiltonian.numQubits,
+			.numTerms = hamiltonian.operators.size(),
+			.numGraphs = graphs.size(),
+			.setupHash = setupHash,
+			.collections = collections,
+			.graphStatistics = graphStatistics,
+			.numGraphEvaluations = numGraphEvaluations,
+			.numExhaustiveGraphEvaluations = numExhaustiveGraphEvaluations,
+			.numPrunedUnits = numPrunedUnits,
+			.elapsedSeconds = previousSeconds + std::chrono::duration<double>(clock::now() - runStart).count(),
+			.secondsPerUnit = secondsPerUnit,
+			.lastCollectionSize = lastCollectionSize
+		};
+		for (const auto& [pauli, _] : paulis) {
+			const auto it = std::ranges::find(hamiltonian.operators, pauli, [](const auto& a) { return a.first; });
+			checkpoint.remaining.push_back(static_cast<size_t>(it - hamiltonian.operators.begin()));
+		}
+		std::ostringstream state;
+		state << randomGenerator;
+		checkpoint.randomGeneratorState = state.str();
+		if (options.graphsEvaluated) checkpoint.graphsEvaluated = *options.graphsEvaluated;
+		writeCheckpoint(options.checkpointFile, checkpoint, hamiltonian);
+	};
+
+	// Choose count graphs: three quarters with the largest upper confidence bound (UCB1, unevaluated graphs first, 
+	// in list order), the rest uniformly at random among the others. Returned in list order to keep the tie-breaking. 
+	auto selectGraphs = [&](size_t count) {
+		std::vector<double> upperBounds(graphs.size());
+		for (size_t g = 0; g < graphs.size(); ++g) {
+			const auto& statistics = graphStatistics[g];
+			upperBounds[g] = statistics.evaluations == 0 ? std::numeric_limits<double>::infinity()
+				: statistics.totalReward / statistics.evaluations + std::sqrt(2. * std::log(static_cast<double>(numGraphEvaluations + 1)) / statistics.evaluations);
+		}
+		std::vector<size_t> order(graphs.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::ranges::stable_sort(order, std::greater{}, [&](size_t g) { return upperBounds[g]; });
+
+		// Graphs that were never evaluated have an infinite bound. Only a quarter of the selection goes to them (in
+		// list order) as long as evaluated graphs are left, otherwise a long graph list would just be swept front to back. 
+		const auto numRandom = count / 4;
+		const auto maxUnevaluated = std::max<size_t>(count / 4, 1);
+		std::vector<size_t> selected;
+		std::vector<bool> chosen(graphs.size());
+		size_t numUnevaluated{};
+		for (int pass = 0; pass < 2; ++pass) {
+			for (auto g : order) {
+				if (selected.size() == count - numRandom) break;
+				if (chosen[g]) continue;
+				if (pass == 0 && graphStatistics[g].evaluations == 0 && numUnevaluated++ >= maxUnevaluated) continue;
+				selected.push_back(g);
+				chosen[g] = true;
+			}
+		}
+		std::vector<size_t> rest;
+		for (auto g : order) {
+			if (!chosen[g]) rest.push_back(g);
+		}
+		std::sample(rest.begin(), rest.end(), std::back_inserter(selected), numRandom, randomGenerator);
+		std::ranges::sort(selected);
+		return selected;
+	};
+
+	size_t initialNumSolves{};
+	for (const auto& finder : finders) initialNumSolves += finder.getNumSolves();
+
+	auto isMeasurable = [&](const std::vector<Pauli>& collection, const GraphRepr& graphRepr, HTCircuitFinder& finder) {
+		const auto paulisKey = cache ? CollectionCache::setFingerprint(collection) : CollectionCache::Fingerprint{};
+		if (cache) {
+			if (const auto known = cache->findFeasibility(graphRepr.graph, paulisKey)) return *known;
+		}
+		const bool measurable = options.incrementalConstraints
+			? finder.findHTCircuitIncremental(graphRepr.graph, collection).has_value()
+			: is_ht_measurable(collection, graphRepr, finder);
+		if (cache) cache->insertFeasibility(graphRepr.graph, paulisKey, measurable);
+		return measurable;
+	};
+
+	while (!paulis.empty()) {
+		if (timed && clock::now() >= deadline) {
+			// Out of time: group the remaining Paulis qubit-wise which needs no solver
+			for (auto& collection : applyTPBGrouper(Hamiltonian{ paulis, hamiltonian.numQubits })) {
+				collections.push_back(std::move(collection));
+				if (options.graphsEvaluated) options.graphsEvaluated->push_back(0);
+				if (options.onCollection) options.onCollection(collections.back());
+			}
+			if (verbose) println("Time budget exhausted, grouped the remaining {} Paulis qubit-wise", paulis.size());
+			break;
+		}
+		const auto iterationStart = clock::now();
+
+		size_t numMainPaulis = std::max(options.numMainPaulis, 1);
+		size_t numGraphs = adaptive ? static_cast<size_t>(options.graphsPerIteration) : graphs.size();
+		if (timed) {
+			if (secondsPerUnit == 0) {
+				numGraphs = std::min(numGraphs, static_cast<size_t>(numThreads)); // first iteration: measure
+			}
+			else {
+				const double remainingSeconds = std::chrono::duration<double>(deadline - clock::now()).count();
+				const double remainingIterations = std::ceil(static_cast<double>(paulis.size()) / static_cast<double>(lastCollectionSize));
+				const double affordableUnits = remainingSeconds / remainingIterations / secondsPerUnit * numThreads;
+				numGraphs = std::min(numGraphs, std::max<size_t>(static_cast<size_t>(affordableUnits / numMainPaulis), 1));
+			}
+			// Use spare threads to try more main Paulis
+			if (numGraphs > 0) numMainPaulis = std::max(numMainPaulis, static_cast<size_t>(numThreads) / numGraphs);
+		}
+		numMainPaulis = std::min(numMainPaulis, paulis.size());
+
+		std::vector<size_t> graphIndices;
+		if (adaptive) {
+			graphIndices = selectGraphs(numGraphs);
+		}
+		else {
+			graphIndices.resize(numGraphs);
+			std::iota(graphIndices.begin(), graphIndices.end(), 0);
+		}
+
+		// For each main Pauli candidate, the remaining Paulis with the main Pauli in front
+		std::vector<std::vector<std::pair<Pauli, double>>> termLists(numMainPaulis);
+		std::vector<CollectionWithGraph> tpbCollections;
+		std::vector<double> tpbScores;
+		for (size_t c = 0; c < numMainPaulis; ++c) {
+			auto& terms = termLists[c];
+			terms.push_back(paulis[c]);
+			for (size_t i = 0; i < paulis.size(); ++i) {
+				if (i != c) terms.push_back(paulis[i]);
+			}
+
+			CollectionWithGraph tpbCollection{ { terms.front().first }, Graph<>{ hamiltonian.numQubits } };
+			double tpbScore = weightOf(terms.front().second);
+			for (const auto& [pauli, coefficient] : terms | std::ranges::views::drop(1)) {
+				if (qubitwiseCommutesWithAll(tpbCollection.paulis, pauli)) {
+					tpbCollection.paulis.push_back(pauli);
+					tpbScore += weightOf(coefficient);
+				}
+			}
+			tpbCollections.push_back(std::move(tpbCollection));
+			tpbScores.push_back(tpbScore);
+		}
+		std::vector<CollectionCache::Fingerprint> fingerprints;
+		if (cache) {
+			for (const auto& terms : termLists) fingerprints.push_back(CollectionCache::fingerprint(terms));
+		}
+
+		// Work is split into units of one main Pauli and one graph
+		const auto numUnits = numMainPaulis * numGraphs;
+		// With speculative insertion and fewer units than threads, each worker handles a single unit and gets 
+		// several finders to test candidates for that graph in parallel. 
+		const bool speculative = options.speculativeInsertion && options.collectionSolver == CollectionSolver::Greedy
+			&& numUnits > 0 && numUnits < static_cast<size_t>(numThreads);
+		const int numWorkers = speculative ? static_cast<int>(numUnits) : numThreads;
+		const size_t findersPerWorker = numThreads / numWorkers;
+
+		std::atomic_int visitedGraphs{};
+		std::atomic_int finishedThreads{};
+		// Best score found so far in this iteration, used to cut off whole-collection solves early
+		std::atomic<double> bestScore{ *std::ranges::max_element(tpbScores) };
+
+		using Terms = std::vector<std::pair<Pauli, double>>;
+
+		// With a time budget, collections are cut short at the deadline (they stay measurable, only smaller)
+		auto expired = [&] { return timed && clock::now() >= deadline; };
+
+		auto buildGreedy = [&](const Terms& terms, const GraphRepr& graphRepr, CollectionWithGraph& collection, std::span<HTCircuitFinder> graphFinders) -> std::optional<double> {
+			auto& finder = graphFinders.front();
+			if (!isMeasurable(collection.paulis, graphRepr, finder)) return std::nullopt;
+
+			if (graphFinders.size() > 1) {
+				// Speculative insertion: test the next candidates that pass the cheap checks in parallel, each one
+				// together with the current collection. Results are committed in coefficient order. Rejections stay
+				// valid after an earlier acceptance (the collection only grows), but a feasible candidate after an
+				// acceptance was tested against an outdated collection, so the next round starts with it. 
+				std::vector<size_t> candidateIndices;
+				std::vector<char> feasible;
+				size_t next = 1;
+				while (next < terms.size() && !expired()) {
+					candidateIndices.clear();
+					auto position = next;
+					for (; position < terms.size() && candidateIndices.size() < graphFinders.size(); ++position) {
+						if (passesCheapChecks(collection.paulis, terms[position].first, graphRepr)) candidateIndices.push_back(position);
+					}
+					if (candidateIndices.empty()) break;
+
+					feasible.assign(candidateIndices.size(), false);
+					{
+						auto test = [&](size_t k) {
+							auto candidateCollection = collection.paulis;
+							candidateCollection.push_back(terms[candidateIndices[k]].first);
+							feasible[k] = isMeasurable(candidateCollection, graphRepr, graphFinders[k]);
+						};
+						std::vector<std::jthread> speculators;
+						for (size_t k = 1; k < candidateIndices.size(); ++k) speculators.emplace_back(test, k);
+						test(0);
+					}
+
+					next = position;
+					bool accepted = false;
+					for (size_t k = 0; k < candidateIndices.size(); ++k) {
+						if (!feasible[k]) continue;
+						if (accepted) {
+							next = candidateIndices[k];
+							break;
+						}
+						collection.paulis.push_back(terms[candidateIndices[k]].first);
+						accepted = true;
+					}
+				}
+				return static_cast<double>(collection.size());
+			}
+
+			if (options.insertionBlockSize <= 1) {
+				insertSequentially(collection.paulis, terms | std::ranges::views::drop(1) | std::ranges::views::keys, graphRepr,
+					[&](const std::vector<Pauli>& paulis) { return isMeasurable(paulis, graphRepr, finder); }, expired);
+				return static_cast<double>(collection.size());
+			}
+
+			// Group testing: push a block of candidates that pass the cheap checks (against the collection and the
+			// block so far) and solve once. If the block is infeasible, bisect for the longest feasible prefix. Feasibility
+			// is monotone in the prefix length, so the first Pauli after that prefix is exactly the one that sequential
+			// insertion would reject next. Scanning resumes right after it. 
+			std::vector<size_t> blockIndices;
+			size_t next = 1;
+			while (next < terms.size() && !expired()) {
+				const auto numAccepted = collection.paulis.size();
+				blockIndices.clear();
+				auto position = next;
+				for (; position < terms.size() && blockIndices.size() < static_cast<size_t>(options.insertionBlockSize); ++position) {
+					const auto& pauli = terms[position].first;
+					if (!passesCheapChecks(collection.paulis, pauli, graphRepr)) continue;
+					collection.paulis.push_back(pauli);
+					blockIndices.push_back(position);
+				}
+				if (blockIndices.empty()) break;
+				if (isMeasurable(collection.paulis, graphRepr, finder)) {
+					next = position;
+					continue;
+				}
+
+				auto withPrefix = [&](size_t length) {
+					collection.paulis.resize(numAccepted);
+					for (size_t i = 0; i < length; ++i) collection.paulis.push_back(terms[blockIndices[i]].first);
+				};
+				size_t feasibleLength = 0;
+				size_t infeasibleLength = blockIndices.size();
+				while (infeasibleLength - feasibleLength > 1) {
+					const auto length = (feasibleLength + infeasibleLength) / 2;
+					withPrefix(length);
+					if (isMeasurable(collection.paulis, graphRepr, finder)) feasibleLength = length;
+					else infeasibleLength = length;
+				}
+				withPrefix(feasibleLength);
+				next = blockIndices[feasibleLength] + 1;
+			}
+			return static_cast<double>(collection.size());
+		};
+
+		auto buildMip = [&](const Terms& terms, const GraphRepr& graphRepr, CollectionWithGraph& collection, HTCircuitFinder& finder) -> std::optional<double> {
+			const auto& mainPauli = terms.front().first;
+			std::vector<Pauli> candidates{ mainPauli };
+			std::vector<double> weights{ weightOf(terms.front().second) };
+			for (const auto& [pauli, coefficient] : terms | std::ranges::views::drop(1)) {
+				if (commutator(mainPauli, pauli) == 1) continue;
+				if (!std::ranges::all_of(graphRepr.connectedComponentSupportVectors, [&](auto supportVector) {
+					return commutesLocally(mainPauli, pauli, supportVector); })) {
+					continue;
+				}
+				candidates.push_back(pauli);
+				weights.push_back(weightOf(coefficient));
+			}
+
+			// The solve may not run past the deadline
+			auto timeLimit = options.mipTimeLimit;
+			if (timed) {
+				timeLimit = std::min(timeLimit, std::chrono::duration<double>(deadline - clock::now()).count());
+				if (timeLimit <= 0) return std::nullopt;
+			}
+			auto result = finder.findMaximalHTMeasurableSubset(graphRepr.graph, candidates, weights, timeLimit, &bestScore);
+			if (!result) return std::nullopt;
+			collection.paulis.clear();
+			for (auto index : result->selected) collection.paulis.push_back(candidates[index]);
+			return result->objective;
+		};
+
+		// Upper bound for the score on a graph: main Pauli plus all Paulis that pass the cheap checks against it
+		auto upperBound = [&](const Terms& terms, const GraphRepr& graphRepr) {
+			const auto& mainPauli = terms.front().first;
+			double bound = weightOf(terms.front().second);
+			for (const auto& [pauli, coefficient] : terms | std::ranges::views::drop(1)) {
+				if (commutator(mainPauli, pauli) == 1) continue;
+				if (!std::ranges::all_of(graphRepr.connectedComponentSupportVectors, [&](auto supportVector) {
+					return commutesLocally(mainPauli, pauli, supportVector); })) {
+					continue;
+				}
+				bound += weightOf(coefficient);
+			}
+			return bound;
+		};
+
+		// Best-so-far collection for pruning, identified by its position in the order in which candidates are 
+		// compared (TPB collection of each main Pauli before its graphs). A unit is skipped if its upper bound 
+		// cannot beat the best collection so far, which leaves the selected collection unchanged. 
+		auto orderKey = [&](size_t unit) { return unit / numGraphs * (numGraphs + 1) + 1 + unit % numGraphs; };
+		std::mutex bestMutex;
+		double bestSoFar = tpbScores.front();
+		size_t bestKey{};
+		for (size_t c = 1; c < numMainPaulis; ++c) {
+			if (tpbScores[c] > bestSoFar) {
+				bestSoFar = tpbScores[c];
+				bestKey = c * (numGraphs + 1);
+			}
+		}
+		constexpr double tolerance = 1e-9;
+
+		struct ScoredCollection {
+			size_t unit{};
+			CollectionWithGraph collection;
+			double score{};
+		};
+
+		struct EvaluatedUnit {
+			size_t unit{};
+			double seconds{};
+			bool pruned{};
+		};
+
+		// Units are handed out in order, so graphs at the front of the list (f.e. from a graph prior) are evaluated 
+		// first and give a good bound for the rest. Each worker takes a contiguous chunk of units, i.e. consecutive 
+		// graphs in Gray-code order, so that incremental solves only patch the rows of one edge between units. Chunks 
+		// start with a single unit and grow along the list, so the front is still spread over all workers. 
+		std::atomic_size_t nextUnit{};
+		constexpr size_t maxChunkSize = 16;
+		auto takeUnit = [&](std::pair<size_t, size_t>& chunk, size_t& unit) {
+			if (chunk.first == chunk.second) {
+				size_t first = nextUnit.load();
+				size_t last{};
+				do {
+					last = std::min(first + std::clamp<size_t>(first / (4 * static_cast<size_t>(numWorkers)), 1, maxChunkSize), numUnits);
+				} while (first < numUnits && !nextUnit.compare_exchange_weak(first, last));
+				chunk = { first, std::max(first, last) };
+			}
+			if (chunk.first >= chunk.second) return false;
+			unit = chunk.first++;
+			return true;
+		};
+
+		auto work = [&](std::vector<ScoredCollection>& partialSolution, std::vector<EvaluatedUnit>& evaluatedUnits, std::span<HTCircuitFinder> workerFinders) {
+			std::pair<size_t, size_t> chunk{};
+			for (size_t unit; takeUnit(chunk, unit);) {
+				if (timed && clock::now() >= deadline) break;
+				++visitedGraphs;
+				const auto unitStart = clock::now();
+				const auto& terms = termLists[unit / numGraphs];
+				const auto& graphRepr = graphReprs[graphIndices[unit % numGraphs]];
+
+				{
+					const auto bound = upperBound(terms, graphRepr);
+					std::scoped_lock lock{ bestMutex };
+					if (bound < bestSoFar - tolerance || (bound <= bestSoFar + tolerance && bestKey < orderKey(unit))) {
+						evaluatedUnits.push_back({ unit, 0., true });
+						continue;
+					}
+				}
+
+				CollectionWithGraph collection{ { terms.front().first }, graphRepr.graph };
+				std::optional<double> score;
+				if (auto cached = cache ? cache->find(graphRepr.graph, fingerprints[unit / numGraphs]) : std::nullopt) {
+					if (*cached) {
+						collection.paulis = std::move(**cached);
+						score = static_cast<double>(collection.size());
+					}
+				}
+				else {
+					score = options.collectionSolver == CollectionSolver::Mip
+						? buildMip(terms, graphRepr, collection, workerFinders.front())
+						: buildGreedy(terms, graphRepr, collection, workerFinders);
+					// A collection that may have been cut short at the deadline is not stored
+					if (cache && !expired()) cache->insert(graphRepr.graph, fingerprints[unit / numGraphs], score ? std::optional{ collection.paulis } : std::nullopt);
+				}
+				evaluatedUnits.push_back({ unit, std::chrono::duration<double>(clock::now() - unitStart).count(), false });
+				if (!score) continue;
+
+				for (auto best = bestScore.load(); *score > best && !bestScore.compare_exchange_weak(best, *score);) {}
+				{
+					std::scoped_lock lock{ bestMutex };
+					if (*score > bestSoFar || (*score == bestSoFar && orderKey(unit) < bestKey)) {
+						bestSoFar = *score;
+						bestKey = orderKey(unit);
+					}
+				}
+
+				partialSolution.push_back({ unit, std::move(collection), *score });
+			}
+			++finishedThreads;
+		};
+
+		std::vector<std::vector<ScoredCollection>> partialSolutions(numWorkers);
+		std::vector<std::vector<EvaluatedUnit>> evaluatedUnits(numWorkers);
+
+		{
+			std::vector<std::jthread> workers;
+			for (int i = 0; i < numWorkers; ++i) {
+				const auto workerFinders = std::span(finders).subspan(findersPerWorker * i, findersPerWorker);
+				workers.emplace_back(work, std::ref(partialSolutions[i]), std::ref(evaluatedUnits[i]), workerFinders);
+			}
+
+			if (verbose) {
+				int previousVisitedGraphs = -1;
+				while (finishedThreads < numWorkers) {
+					if (int currentlyVisitedGraphs = visitedGraphs.load(); currentlyVisitedGraphs != previousVisitedGraphs) {
+						print("\33[2K\rGraph {:>4} of {:>4}", visitedGraphs.load(), numUnits);
+						previousVisitedGraphs = currentlyVisitedGraphs;
+					}
+					using namespace std::chrono_literals;
+					std::this_thread::sleep_for(10ms);
+				}
+			}
+		}
+
+		// Candidates are compared in the order TPB collection of the first main Pauli, its graphs in order, 
+		// TPB collection of the second main Pauli, ... and the first best one is selected. 
+		std::vector<ScoredCollection> scoredCollections;
+		for (auto& partialSolution : partialSolutions) std::ranges::move(partialSolution, std::back_inserter(scoredCollections));
+		std::ranges::sort(scoredCollections, std::less{}, &ScoredCollection::unit);
+
+		const CollectionWithGraph* bestCollection = nullptr;
+		double bestCollectionScore{};
+		auto consider = [&](const CollectionWithGraph& collection, double score) {
+			if (bestCollection && score <= bestCollectionScore) return;
+			bestCollection = &collection;
+			bestCollectionScore = score;
+		};
+		size_t nextTpb = 0;
+		for (const auto& [unit, collection, score] : scoredCollections) {
+			for (; nextTpb <= unit / numGraphs; ++nextTpb) consider(tpbCollections[nextTpb], tpbScores[nextTpb]);
+			consider(collection, score);
+		}
+		for (; nextTpb < numMainPaulis; ++nextTpb) consider(tpbCollections[nextTpb], tpbScores[nextTpb]);
+
+		std::vector<bool> graphEvaluated(graphs.size());
+		size_t iterationEvaluations{};
+		for (const auto& units : evaluatedUnits) {
+			for (const auto& [unit, seconds, pruned] : units) {
+				// Pruned graphs count as evaluations without reward for the adaptive selection
+				const auto graphIndex = graphIndices[unit % numGraphs];
+				++graphStatistics[graphIndex].evaluations;
+				if (pruned) {
+					++numPrunedUnits;
+					continue;
+				}
+				graphEvaluated[graphIndex] = true;
+				graphStatistics[graphIndex].totalSeconds += seconds;
+				++numGraphEvaluations;
+				++iterationEvaluations;
+			}
+		}
+		for (const auto& [unit, collection, score] : scoredCollections) {
+			auto& statistics = graphStatistics[graphIndices[unit % numGraphs]];
+			++statistics.feasible;
+			// All weighted scores may be 0 (f.e. only zero coefficients left), then every feasible graph is a full success
+			statistics.totalReward += bestCollectionScore > 0 ? score / bestCollectionScore : 1.;
+			statistics.totalSize += static_cast<double>(collection.size());
+			if (&collection == bestCollection) ++statistics.wins;
+		}
+		numExhaustiveGraphEvaluations += numMainPaulis * graphs.size();
+
+		collections.push_back(*bestCollection);
+		auto& collection = collections.back();
+		for (const auto& pauli : collection.paulis) {
+			std::erase_if(paulis, [&pauli](auto& val) { return val.first == pauli; });
+		}
+		if (collection.graph.edgeCount() == 0) collection.singleQubitLayer = computeQubitWiseLayer(collection.paulis, hamiltonian.numQubits);
+		else computeSingleQubitLayer(collection, finders.front());
+		if (options.onCollection) options.onCollection(collection);
+
+		if (options.graphsEvaluated) options.graphsEvaluated->push_back(std::ranges::count(graphEvaluated, true));
+		// Pruned units take almost no time, so only evaluated units enter the estimate for the next iteration
+		if (iterationEvaluations > 0) {
+			const auto concurrency = std::min(iterationEvaluations, static_cast<size_t>(numWorkers));
+			secondsPerUnit = std::chrono::duration<double>(clock::now() - iterationStart).count() * static_cast<double>(concurrency) / static_cast<double>(iterationEvaluations);
+		}
+		lastCollectionSize = collection.size();
+
+		if (verbose) println("\33[2K\r{} of {} remaining ({} group{}): {} -> {}\n",
+			paulis.size(), hamiltonian.operators.size(), collections.size(), collections.size() == 1 ? "" : "s",
+			collection.paulis, collection.graph.getEdges());
+
+		if (!options.checkpointFile.empty() && !paulis.empty()
+			&& std::chrono::duration<double>(clock::now() - lastCheckpoint).count() >= options.checkpointInterval) {
+			saveCheckpoint();
+			lastCheckpoint = clock::now();
+			if (verbose) println("Wrote checkpoint to {}\n", options.checkpointFile);
+		}
+	}
+
+	if (!tail.empty()) {
+		const auto numCollections = collections.size();
+		const auto numInserted = insertTailPaulis(collections, tail, hamiltonian.numQubits);
+		if (options.graphsEvaluated) options.graphsEvaluated->resize(collections.size());
+		if (verbose) println("Tail: {} Paulis with |coefficient| < {}, {} inserted into existing groups, {} grouped qubit-wise into {} new group{}",
+			tail.size(), options.tailThreshold, numInserted, tail.size() - numInserted, collections.size() - numCollections, collections.size() - numCollections == 1 ? "" : "s");
+	}
+
+	if (verbose) println("Skipped {} graph evaluations that could not beat the best collection so far", numPrunedUnits);
+	if (adaptive && verbose) {
+		size_t numSolves{};
+		for (const auto& finder : finders) numSolves += finder.getNumSolves();
+		numSolves -= initialNumSolves;
+		const auto solvesPerEvaluation = numGraphEvaluations == 0 ? 0. : static_cast<double>(numSolves) / numGraphEvaluations;
+		println("Adaptive graph selection: {} of {} graph evaluations, {} solver calls (about {:.0f} saved)",
+			numGraphEvaluations, numExhaustiveGraphEvaluations, numSolves, solvesPerEvaluation * (numExhaustiveGraphEvaluations - numGraphEvaluations));
+
+		std::vector<size_t> order(graphs.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::ranges::stable_sort(order, std::greater{}, [&](size_t g) { return graphStatistics[g].wins; });
+		for (auto g : order | std::ranges::views::take(5)) {
+			const auto& statistics = graphStatistics[g];
+			if (statistics.wins == 0) break;
+			println("  {} wins, {}/{} feasible, mean size {:.1f}, mean time {:.3f}s: {}", statistics.wins, statistics.feasible, statistics.evaluations,
+				statistics.totalSize / std::max<size_t>(statistics.feasible, 1), statistics.totalSeconds / statistics.evaluations, graphs[g].getEdges());
+		}
+	}
+	return collections;
+}
+
+
+
+std::vector<CollectionWithGraph> Q::applyPauliGrouperVariableGraph(const Hamiltonian& hamiltonian, const Graph<>& connectivity, int maxEdgeCount, const GrouperOptions& options) {
+	VariableGraphHTCircuitFinder finder{ connectivity, maxEdgeCount, options.numThreads };
+
+	auto paulis = hamiltonian.operators;
+	// Sort by magnitude in descending order 
+	std::ranges::sort(paulis, [](const auto& a, const auto& b) {return std::abs(a.second) > std::abs(b.second); });
+
+	std::vector<CollectionWithGraph> collections;
+
 	while (!paulis.empty()) {
 		const auto& mainPauli = paulis.front().first;
 
@@ -351,42 +1071,279 @@ std::vector<CollectionWithGraph> Q::applyPauliGrouper2Multithread2(const Hamilto
 			}
 		}
 
+		finder.clear();
+		CollectionWithGraph collection{ {}, Graph<>{ hamiltonian.numQubits } };
+		int j{};
+		for (const auto& [pauli, _] : paulis) {
+			if (options.verbose) print("\33[2K\rPauli {:>4} of {:>4}", j++, paulis.size());
+			if (!commutesWithAll(collection.paulis, pauli)) continue;
+			if (finder.tryAddPauli(pauli)) {
+				collection.paulis.push_back(pauli);
+			}
+		}
+		collection.graph = finder.getGraph();
+
+		const auto& bestCollection = collection.size() > tpbCollection.size() ? collection : tpbCollection;
+		collections.push_back(bestCollection);
+		for (const auto& pauli : bestCollection.paulis) {
+			std::erase_if(paulis, [&pauli](auto& val) { return val.first == pauli; });
+		}
+		if (options.verbose) println("\33[2K\r{} of {} remaining ({} group{}): {} -> {}\n",
+			paulis.size(), hamiltonian.operators.size(), collections.size(), collections.size() == 1 ? "" : "s",
+			collections.back().paulis, collections.back().graph.getEdges());
+	}
+	computeSingleQubitLayer(collections);
+	return collections;
+}
+
+
+
+std::vector<CollectionWithGraph> Q::applyTPBGrouper(const Hamiltonian& hamiltonian, bool verbose) {
+	auto paulis = hamiltonian.operators;
+	// Sort by magnitude in descending order 
+	std::ranges::sort(paulis, [](const auto& a, const auto& b) {return std::abs(a.second) > std::abs(b.second); });
+
+	std::vector<CollectionWithGraph> collections;
+	std::vector<bool> grouped(paulis.size());
+	size_t numGrouped{};
+
+	for (size_t first = 0; first < paulis.size(); ++first) {
+		if (grouped[first]) continue;
+
+		CollectionWithGraph collection{ {}, Graph<>{ hamiltonian.numQubits } };
+		// Union of the x and z strings of the collection, on qubits where the collection acts non-trivially a 
+		// candidate needs to have the same letter. 
+		Pauli::Bitstring xString{};
+		Pauli::Bitstring zString{};
+		for (size_t i = first; i < paulis.size(); ++i) {
+			if (grouped[i]) continue;
+			const auto& pauli = paulis[i].first;
+			const auto support = ~pauli.getIdentityString() & (xString | zString);
+			if ((((pauli.getXString() ^ xString) | (pauli.getZString() ^ zString)) & support) != 0) continue;
+
+			collection.paulis.push_back(pauli);
+			xString |= pauli.getXString();
+			zString |= pauli.getZString();
+			grouped[i] = true;
+			++numGrouped;
+		}
+
+		collection.singleQubitLayer = computeQubitWiseLayer(collection.paulis, hamiltonian.numQubits);
+		collections.push_back(std::move(collection));
+
+		if (verbose) println("\33[2K\r{} of {} remaining ({} group{}): {}",
+			paulis.size() - numGrouped, paulis.size(), collections.size(), collections.size() == 1 ? "" : "s", collections.back().paulis);
+	}
+	return collections;
+}
+
+
+double Q::tailThresholdForWeightFraction(const Hamiltonian& hamiltonian, double fraction) {
+	std::vector<double> magnitudes;
+	for (const auto& [_, coefficient] : hamiltonian.operators) magnitudes.push_back(std::abs(coefficient));
+	std::ranges::sort(magnitudes);
+
+	const auto maxTailWeight = fraction * std::accumulate(magnitudes.begin(), magnitudes.end(), 0.);
+	double tailWeight{};
+	for (auto magnitude : magnitudes) {
+		tailWeight += magnitude;
+		if (tailWeight > maxTailWeight) return magnitude;
+	}
+	return std::numeric_limits<double>::infinity();
+}
+
+
+Q::DiagonalizationCheck::DiagonalizationCheck(const CollectionWithGraph& collection, int numQubits)
+	: numQubits(numQubits), qubitWise(collection.graph.edgeCount() == 0) {
+
+	// The circuit of a collection diagonalizes a Pauli (x, z) if the images x' = Axx x + Axz z and z' = Azx x + Azz z
+	// under the single-qubit layer satisfy z' = Γ x' (Γ: adjacency matrix of the graph). The layer is stored as one
+	// mask per matrix entry and Γ as one neighbourhood mask per qubit. 
+	if (qubitWise) {
+		for (const auto& pauli : collection.paulis) add(pauli);
+		return;
+	}
+	for (int qubit = 0; qubit < std::ssize(collection.singleQubitLayer); ++qubit) {
+		const auto& gate = collection.singleQubitLayer[qubit];
+		axx |= static_cast<Bitstring>(gate(0, 0).toInt()) << qubit;
+		axz |= static_cast<Bitstring>(gate(0, 1).toInt()) << qubit;
+		azx |= static_cast<Bitstring>(gate(1, 0).toInt()) << qubit;
+		azz |= static_cast<Bitstring>(gate(1, 1).toInt()) << qubit;
+	}
+	neighbours.resize(numQubits);
+	for (const auto& [i, j] : collection.graph.getEdges()) {
+		neighbours[i] |= Bitstring{ 1 } << j;
+		neighbours[j] |= Bitstring{ 1 } << i;
+	}
+}
+
+bool Q::DiagonalizationCheck::diagonalizes(const Pauli& pauli) const {
+	const auto x = pauli.getXString();
+	const auto z = pauli.getZString();
+	if (qubitWise) {
+		const auto support = ~pauli.getIdentityString() & (xString | zString);
+		return (((x ^ xString) | (z ^ zString)) & support) == 0;
+	}
+	const auto xImage = (axx & x) ^ (axz & z);
+	const auto zImage = (azx & x) ^ (azz & z);
+	for (int qubit = 0; qubit < numQubits; ++qubit) {
+		if (((zImage >> qubit) & 1) != (std::popcount(neighbours[qubit] & xImage) & 1)) return false;
+	}
+	return true;
+}
+
+void Q::DiagonalizationCheck::add(const Pauli& pauli) {
+	if (!qubitWise) return;
+	xString |= pauli.getXString();
+	zString |= pauli.getZString();
+}
+
+
+size_t Q::insertTailPaulis(std::vector<CollectionWithGraph>& grouping, const std::vector<std::pair<Pauli, double>>& paulis, int numQubits) {
+	std::vector<DiagonalizationCheck> checks;
+	for (const auto& collection : grouping) checks.emplace_back(collection, numQubits);
+
+	std::vector<bool> modified(grouping.size());
+	std::vector<std::pair<Pauli, double>> leftovers;
+	for (const auto& term : paulis) {
+		const auto& pauli = term.first;
+		const auto it = std::ranges::find_if(checks, [&](const auto& check) { return check.diagonalizes(pauli); });
+		if (it == checks.end()) {
+			leftovers.push_back(term);
+			continue;
+		}
+		const auto index = it - checks.begin();
+		grouping[index].paulis.push_back(pauli);
+		if (it->isQubitWise()) {
+			it->add(pauli);
+			modified[index] = true;
+		}
+	}
+	for (size_t i = 0; i < grouping.size(); ++i) {
+		if (modified[i]) grouping[i].singleQubitLayer = computeQubitWiseLayer(grouping[i].paulis, numQubits);
+	}
+
+	for (auto& collection : applyTPBGrouper(Hamiltonian{ leftovers, numQubits })) grouping.push_back(std::move(collection));
+	return paulis.size() - leftovers.size();
+}
+
+
+
+std::optional<std::pair<size_t, CollectionWithGraph>> Q::findBestCollection(const std::vector<Pauli>& terms, const std::vector<Graph<>>& graphs, std::span<HTCircuitFinder> finders, bool incrementalConstraints) {
+	std::vector<GraphRepr> graphReprs;
+	for (const auto& graph : graphs) graphReprs.emplace_back(graph);
+
+	auto isMeasurable = [&](const std::vector<Pauli>& collection, const GraphRepr& graphRepr, HTCircuitFinder& finder) {
+		if (incrementalConstraints) return finder.findHTCircuitIncremental(graphRepr.graph, collection).has_value();
+		return is_ht_measurable(collection, graphRepr, finder);
+	};
+
+	// Sequential insertion on each graph, one graph per thread at a time
+	std::vector<std::optional<CollectionWithGraph>> results(graphs.size());
+	std::atomic_size_t nextGraph{};
+	auto work = [&](HTCircuitFinder& finder) {
+		for (size_t g; (g = nextGraph++) < graphs.size();) {
+			const auto& graphRepr = graphReprs[g];
+			CollectionWithGraph collection{ { terms.front() }, graphRepr.graph };
+			if (!isMeasurable(collection.paulis, graphRepr, finder)) continue;
+
+			insertSequentially(collection.paulis, terms | std::ranges::views::drop(1), graphRepr,
+				[&](const std::vector<Pauli>& paulis) { return isMeasurable(paulis, graphRepr, finder); }, [] { return false; });
+			results[g] = std::move(collection);
+		}
+	};
+	{
+		std::vector<std::jthread> workers;
+		for (size_t i = 1; i < finders.size(); ++i) workers.emplace_back(work, std::ref(finders[i]));
+		work(finders.front());
+	}
+
+	std::optional<std::pair<size_t, CollectionWithGraph>> best;
+	for (size_t g = 0; g < graphs.size(); ++g) {
+		if (!results[g]) continue;
+		if (!best || results[g]->size() > best->second.size()) best.emplace(g, std::move(*results[g]));
+	}
+	return best;
+}
+
+
+std::vector<CollectionWithGraph> Q::applyQWCGroupMerging(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, const GrouperOptions& options) {
+	const auto numThreads = options.numThreads;
+	const auto verbose = options.verbose;
+	const auto numGraphsPerThread = static_cast<size_t>(std::ceil(static_cast<float>(graphs.size()) / static_cast<float>(numThreads)));
+	std::vector<HTCircuitFinder> ownFinders;
+	auto& finders = options.finders ? *options.finders : ownFinders;
+	while (finders.size() < static_cast<size_t>(numThreads)) finders.emplace_back(hamiltonian.numQubits);
+
+	std::vector<GraphRepr> graphReprs;
+	for (const auto& graph : graphs) graphReprs.emplace_back(graph);
+
+	const auto qwcGroups = applyTPBGrouper(hamiltonian);
+	const auto numGroups = qwcGroups.size();
+	const auto numWords = (numGroups + 63) / 64;
+
+	// Bit matrix with bit j of row i set if all Paulis of QWC groups i and j commute
+	std::vector<std::vector<uint64_t>> commutingGroups(numGroups, std::vector<uint64_t>(numWords));
+	for (size_t i = 0; i < numGroups; ++i) {
+		for (size_t j = i; j < numGroups; ++j) {
+			const bool commuting = std::ranges::all_of(qwcGroups[j].paulis, [&](const auto& pauli) { return commutesWithAll(qwcGroups[i].paulis, pauli); });
+			if (!commuting) continue;
+			commutingGroups[i][j / 64] |= 1ULL << (j % 64);
+			commutingGroups[j][i / 64] |= 1ULL << (i % 64);
+		}
+	}
+
+	auto isMeasurable = [&](const std::vector<Pauli>& collection, const GraphRepr& graphRepr, HTCircuitFinder& finder) {
+		if (options.incrementalConstraints) return finder.findHTCircuitIncremental(graphRepr.graph, collection).has_value();
+		return is_ht_measurable(collection, graphRepr, finder);
+	};
+
+	std::vector<size_t> remainingGroups(numGroups);
+	std::iota(remainingGroups.begin(), remainingGroups.end(), 0);
+	std::vector<CollectionWithGraph> collections;
+
+	while (!remainingGroups.empty()) {
+		const auto seed = remainingGroups.front();
+
+		// Collection of a graph together with the indices of the merged QWC groups
+		using MergedCollection = std::pair<CollectionWithGraph, std::vector<size_t>>;
+
 		std::atomic_int visitedGraphs{};
 		std::atomic_int finishedThreads{};
 
-		auto work = [&](size_t first, size_t last, std::vector<CollectionWithGraph>& partialSolution, HTCircuitFinder& finder) {
+		auto work = [&](size_t first, size_t last, std::vector<MergedCollection>& partialSolution, HTCircuitFinder& finder) {
 			for (auto i = first; i < last; ++i) {
 				++visitedGraphs;
 				const auto& graphRepr = graphReprs[i];
-				const auto& graph = graphRepr.graph;
-				CollectionWithGraph collection{ { mainPauli }, graph };
-				if (!is_ht_measurable(collection.paulis, graphRepr, finder)) continue;
-
-				for (const auto& [pauli, _] : paulis | std::ranges::views::drop(1)) {
-					if (!commutesWithAll(collection.paulis, pauli)) continue;
-
-					bool ouch{};
+				MergedCollection merged{ { qwcGroups[seed].paulis, graphRepr.graph }, { seed } };
+				auto& [collection, groupIndices] = merged;
+				if (!isMeasurable(collection.paulis, graphRepr, finder)) continue;
+
+				// Groups that commute with every group merged so far
+				auto commutingMask = commutingGroups[seed];
+				for (auto group : remainingGroups | std::ranges::views::drop(1)) {
+					if (!(commutingMask[group / 64] & (1ULL << (group % 64)))) continue;
+					const auto& groupPaulis = qwcGroups[group].paulis;
 					if (!std::ranges::all_of(graphRepr.connectedComponentSupportVectors, [&](auto supportVector) {
-						return locallyCommutesWithAll(collection.paulis, pauli, supportVector); })) {
+						return std::ranges::all_of(groupPaulis, [&](const auto& pauli) { return locallyCommutesWithAll(collection.paulis, pauli, supportVector); }); })) {
 						continue;
 					}
 
-					//if (graphRepr.connectedComponents.back().size() <= 2) {
-					//	collection.paulis.push_back(pauli);
-					//	continue;
-					//}
-
-					collection.paulis.push_back(pauli);
-					if (!is_ht_measurable(collection.paulis,graphRepr, finder)) {
-						collection.paulis.pop_back();
+					const auto previousSize = collection.size();
+					collection.paulis.insert(collection.paulis.end(), groupPaulis.begin(), groupPaulis.end());
+					if (!isMeasurable(collection.paulis, graphRepr, finder)) {
+						collection.paulis.resize(previousSize);
+						continue;
 					}
+					groupIndices.push_back(group);
+					for (size_t w = 0; w < numWords; ++w) commutingMask[w] &= commutingGroups[group][w];
 				}
-				partialSolution.push_back(collection);
+				if (groupIndices.size() > 1) partialSolution.push_back(std::move(merged));
 			}
 			++finishedThreads;
 		};
 
-		std::vector<std::vector<CollectionWithGraph>> partialSolutions(numThreads);
+		std::vector<std::vector<MergedCollection>> partialSolutions(numThreads);
 
 		{
 			std::vector<std::jthread> workers;
@@ -409,20 +1366,188 @@ std::vector<CollectionWithGraph> Q::applyPauliGrouper2Multithread2(const Hamilto
 			}
 		}
 
-		const auto* bestCollection = &tpbCollection;
+		const MergedCollection seedOnly{ qwcGroups[seed], { seed } };
+		const auto* best = &seedOnly;
 		for (const auto& partialSolution : partialSolutions) {
-			for (const auto& collection : partialSolution) {
-				if (collection.size() > bestCollection->size()) bestCollection = &collection;
+			for (const auto& merged : partialSolution) {
+				if (merged.first.size() > best->first.size()) best = &merged;
 			}
 		}
-		collections.push_back(*bestCollection);
-		for (const auto& pauli : bestCollection->paulis) {
-			std::erase_if(paulis, [&pauli](auto& val) { return val.first == pauli; });
-		}
-		if (verbose) println("\33[2K\r{} of {} remaining ({} group{}): {} -> {}\n",
-			paulis.size(), hamiltonian.operators.size(), collections.size(), collections.size() == 1 ? "" : "s",
+		collections.push_back(best->first);
+		std::erase_if(remainingGroups, [&](auto group) { return std::ranges::find(best->second, group) != best->second.end(); });
+
+		if (verbose) println("\33[2K\r{} of {} QWC groups remaining ({} group{}): {} -> {}\n",
+			remainingGroups.size(), numGroups, collections.size(), collections.size() == 1 ? "" : "s",
 			collections.back().paulis, collections.back().graph.getEdges());
 	}
 	computeSingleQubitLayer(collections);
 	return collections;
 }
+
+
+
+std::vector<CollectionWithGraph> Q::refineGrouping(const Hamiltonian& hamiltonian, const std::vector<CollectionWithGraph>& grouping, double timeBudget, const GrouperOptions& options) {
+	using clock = std::chrono::steady_clock;
+	const auto deadline = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(timeBudget));
+
+	// The numerator of the estimated shot reduction does not change when Paulis are moved, so a move is an 
+	// improvement iff it decreases the sum over all collections of the square root of their summed squared 
+	// coefficients. 
+	struct Group {
+		std::vector<size_t> terms;
+		GraphRepr graphRepr;
+		double sumOfSquares{};
+		uint64_t version{};
+		bool modified{};
+	};
+	struct Move {
+		double change{};
+		size_t target{};
+		std::vector<size_t> terms;
+		double weight{};
+	};
+
+	std::vector<Pauli> paulis;
+	std::vector<double> squaredCoefficients;
+	std::vector<size_t> groupOfTerm;
+	std::vector<Group> groups;
+	for (const auto& collection : grouping) {
+		Group group{ {}, GraphRepr{ collection.graph } };
+		for (const auto& pauli : collection.paulis) {
+			const auto it = std::ranges::find(hamiltonian.operators, pauli, [](const auto& a) { return a.first; });
+			const bool measured = it != hamiltonian.operators.end() && pauli != Pauli::Identity(hamiltonian.numQubits);
+			group.terms.push_back(paulis.size());
+			group.sumOfSquares += measured ? it->second * it->second : 0.;
+			paulis.push_back(pauli);
+			squaredCoefficients.push_back(measured ? it->second * it->second : 0.);
+			groupOfTerm.push_back(groups.size());
+		}
+		groups.push_back(std::move(group));
+	}
+
+	auto isMeasurable = [&](const std::vector<Pauli>& collection, const GraphRepr& graphRepr, HTCircuitFinder& finder) {
+		if (options.incrementalConstraints) return finder.findHTCircuitIncremental(graphRepr.graph, collection).has_value();
+		return is_ht_measurable(collection, graphRepr, finder);
+	};
+
+	// Change of the objective when moving Paulis with summed squared coefficients of weight from source to target
+	auto changeOf = [&](size_t source, size_t target, double weight) {
+		const auto sourceSum = groups[source].sumOfSquares;
+		const auto targetSum = groups[target].sumOfSquares;
+		return std::sqrt(std::max(0., sourceSum - weight)) - std::sqrt(sourceSum) + std::sqrt(targetSum + weight) - std::sqrt(targetSum);
+	};
+	constexpr double minImprovement = 1e-12;
+
+	std::mutex mutex;
+	std::atomic_size_t acceptedMoves{};
+	std::atomic_bool converged{};
+
+	// Try moving the given Pauli (alone or with a random partner from its collection) to the collection with the best 
+	// improvement that can measure it. Returns true if a move was applied. 
+	auto tryMove = [&](size_t term, HTCircuitFinder& finder, std::mt19937_64& rng) {
+		std::vector<Move> moves;
+		size_t source{};
+		{
+			std::scoped_lock lock{ mutex };
+			source = groupOfTerm[term];
+			const auto& sourceTerms = groups[source].terms;
+			std::vector<std::vector<size_t>> movedTerms{ { term } };
+			if (sourceTerms.size() >= 2) {
+				std::uniform_int_distribution<size_t> distribution{ 0, sourceTerms.size() - 2 };
+				auto partner = sourceTerms[distribution(rng)];
+				if (partner == term) partner = sourceTerms.back();
+				movedTerms.push_back({ term, partner });
+			}
+			for (const auto& terms : movedTerms) {
+				double weight{};
+				for (auto t : terms) weight += squaredCoefficients[t];
+				for (size_t target = 0; target < groups.size(); ++target) {
+					if (target == source || groups[target].terms.empty()) continue;
+					if (const auto change = changeOf(source, target, weight); change < -minImprovement) moves.push_back({ change, target, terms, weight });
+				}
+			}
+		}
+		std::ranges::sort(moves, std::less{}, &Move::change);
+
+		for (const auto& move : moves) {
+			std::vector<Pauli> collection;
+			uint64_t sourceVersion{}, targetVersion{};
+			{
+				std::scoped_lock lock{ mutex };
+				if (std::ranges::any_of(move.terms, [&](auto t) { return groupOfTerm[t] != source; })) return false;
+				sourceVersion = groups[source].version;
+				targetVersion = groups[move.target].version;
+				for (auto t : groups[move.target].terms) collection.push_back(paulis[t]);
+			}
+
+			const auto& graphRepr = groups[move.target].graphRepr;
+			bool feasible = true;
+			for (auto t : move.terms) {
+				feasible = commutesWithAll(collection, paulis[t]) && std::ranges::all_of(graphRepr.connectedComponentSupportVectors, [&](auto supportVector) {
+					return locallyCommutesWithAll(collection, paulis[t], supportVector); });
+				if (!feasible) break;
+				collection.push_back(paulis[t]);
+			}
+			if (!feasible || !isMeasurable(collection, graphRepr, finder)) continue;
+
+			std::scoped_lock lock{ mutex };
+			if (groups[source].version != sourceVersion || groups[move.target].version != targetVersion) continue;
+			// The gain was computed under an earlier lock, other moves may have changed the two collections since
+			if (changeOf(source, move.target, move.weight) >= -minImprovement) continue;
+			for (auto t : move.terms) {
+				std::erase(groups[source].terms, t);
+				groups[move.target].terms.push_back(t);
+				groups[source].sumOfSquares -= squaredCoefficients[t];
+				groups[move.target].sumOfSquares += squaredCoefficients[t];
+				groupOfTerm[t] = move.target;
+			}
+			for (auto g : { source, move.target }) {
+				++groups[g].version;
+				groups[g].modified = true;
+			}
+			++acceptedMoves;
+			return true;
+		}
+		return false;
+	};
+
+	// Each thread visits all Paulis in random order. A full pass without any accepted move (by any thread) 
+	// means that no single move improves the grouping anymore. 
+	auto work = [&](int threadIndex, HTCircuitFinder& finder) {
+		std::mt19937_64 rng{ static_cast<uint64_t>(threadIndex) };
+		std::vector<size_t> order(paulis.size());
+		std::iota(order.begin(), order.end(), 0);
+		while (!converged) {
+			std::ranges::shuffle(order, rng);
+			const auto acceptedBefore = acceptedMoves.load();
+			for (auto term : order) {
+				if (converged || clock::now() >= deadline) return;
+				tryMove(term, finder, rng);
+			}
+			if (acceptedMoves == acceptedBefore) converged = true;
+		}
+	};
+
+	std::vector<HTCircuitFinder> ownFinders;
+	auto& finders = options.finders ? *options.finders : ownFinders;
+	while (finders.size() < static_cast<size_t>(options.numThreads)) finders.emplace_back(hamiltonian.numQubits);
+	{
+		std::vector<std::jthread> workers;
+		for (int i = 0; i < options.numThreads; ++i) workers.emplace_back(work, i, std::ref(finders[i]));
+	}
+
+	std::vector<CollectionWithGraph> refined;
+	for (size_t g = 0; g < groups.size(); ++g) {
+		if (groups[g].terms.empty()) continue;
+		if (!groups[g].modified) {
+			refined.push_back(grouping[g]);
+			continue;
+		}
+		CollectionWithGraph collection{ {}, grouping[g].graph };
+		for (auto t : groups[g].terms) collection.paulis.push_back(paulis[t]);
+		computeSingleQubitLayer(collection, finders.front());
+		refined.push_back(std::move(collection));
+	}
+	if (options.verbose) println("Refinement: {} moves, {} -> {} groups{}", acceptedMoves.load(), grouping.size(), refined.size(), converged ? " (converged)" : "");
+	return refined;
+}
@@ -3,6 +3,15 @@
 #include "graph.h"
 #include "hamiltonian.h"
 #include "ht_circuits.h"
+#include <optional>
+#include <functional>
+#include <string>
+#include <span>
+#include <array>
+#include <atomic>
+#include <map>
+#include <deque>
+#include <shared_mutex>
 
 
 namespace Q {
@@ -18,11 +27,141 @@ namespace Q {
 	};
 
 	class HTCircuitFinder;
+	struct GrouperCheckpoint;
+
+
+	/// @brief Method used to build the collection for the main Pauli with a single graph.
+	enum class CollectionSolver {
+		Greedy,  // Try each commuting candidate in turn (one solve per candidate)
+		Mip      // Choose the maximal HT-measurable subset with a single solve per graph
+	};
+
+	/// @brief Collections found by the greedy collection solver, keyed by graph and by the ordered list of remaining 
+	///        terms (main Pauli first). The greedy result only depends on these two, so runs on nested graph sets
+	///        (f.e. a sweep over numGraphs with the same seed) can reuse the work of previous runs as long as they 
+	///        choose the same collections. Terms are identified by a 128 bit fingerprint. 
+	/// 
+	///        Also keeps the answers of single feasibility checks, keyed by graph and the set of Paulis. These do not 
+	///        depend on the coefficients, so they are shared f.e. by the points of a scan over coefficient vectors 
+	///        even where a different term order leads to different collections. Thread-safe. 
+	/// 
+	///        Each of the two tables holds at most maxEntries entries, the oldest entries are evicted first. 
+	class CollectionCache {
+	public:
+		using Fingerprint = std::array<uint64_t, 2>;
+
+		explicit CollectionCache(size_t maxEntries = size_t{ 1 } << 18) : maxEntries(maxEntries) {}
+
+		static Fingerprint fingerprint(std::span<const std::pair<Pauli, double>> terms);
+		/// @brief Fingerprint of a set of Paulis, independent of their order
+		static Fingerprint setFingerprint(std::span<const Pauli> paulis);
+
+		/// @brief Cached collection (nullopt inside if the main Pauli alone is not measurable with the graph) or 
+		///        nullopt if the unit has not been evaluated yet. 
+		std::optional<std::optional<std::vector<Pauli>>> find(const Graph<>& graph, const Fingerprint& terms) const;
+		void insert(const Graph<>& graph, const Fingerprint& terms, std::optional<std::vector<Pauli>> collection);
+
+		std::optional<bool> findFeasibility(const Graph<>& graph, const Fingerprint& paulis) const;
+		void insertFeasibility(const Graph<>& graph, const Fingerprint& paulis, bool measurable);
+
+		/// @brief Stop storing new results (lookups still work), f.e. for the last run that can use the cache. 
+		void setReadOnly(bool value) { readOnly = value; }
+
+		size_t size() const;
+		size_t numLookups() const { return lookups; }
+		size_t numHits() const { return hits; }
+		size_t numFeasibilityHits() const { return feasibilityHits; }
+
+	private:
+		using Key = std::pair<std::vector<std::pair<int, int>>, Fingerprint>;
+
+		/// @brief Insert into one of the tables and evict its oldest entry if it is full. 
+		template<class Value>
+		void insertBounded(std::map<Key, Value>& table, std::deque<typename std::map<Key, Value>::iterator>& order, Key key, Value value);
+
+		size_t maxEntries{};
+		std::atomic_bool readOnly{};
+		mutable std::shared_mutex mutex;
+		std::map<Key, std::optional<std::vector<Pauli>>> entries;
+		std::map<Key, bool> feasibility;
+		// Entries of both tables in insertion order
+		std::deque<std::map<Key, std::optional<std::vector<Pauli>>>::iterator> entryOrder;
+		std::deque<std::map<Key, bool>::iterator> feasibilityOrder;
+		mutable std::atomic_size_t lookups{};
+		mutable std::atomic_size_t hits{};
+		mutable std::atomic_size_t feasibilityHits{};
+	};
+
+	struct GrouperOptions {
+		int numThreads{ 1 };
+		bool verbose{ true };
+
+		CollectionSolver collectionSolver{ CollectionSolver::Greedy };
+		// Time limit in seconds for a single whole-collection solve (CollectionSolver::Mip only).
+		double mipTimeLimit{ 10. };
+		// Maximize the summed absolute coefficients instead of the number of Paulis (CollectionSolver::Mip only).
+		bool mipWeighted{ false };
+
+		// Keep parity rows in the solver model between feasibility checks and only patch the rows that changed 
+		// (CollectionSolver::Greedy only). Most effective with graphs sorted by sortByGrayCode(). 
+		bool incrementalConstraints{ false };
+		// Number of candidates that are pushed onto a collection at once and accepted with a single solve if feasible.
+		// Infeasible blocks are bisected, the result is the same as with sequential insertion (CollectionSolver::Greedy only). 
+		int insertionBlockSize{ 1 };
+		// If there are fewer graphs than threads, give each graph several solver instances and test that many candidates
+		// against the current collection at once. The result is the same as with sequential insertion and 
+		// insertionBlockSize is ignored for such graphs (CollectionSolver::Greedy only). 
+		bool speculativeInsertion{ false };
+
+		// Wall-clock budget in seconds (0: none). Each iteration then only evaluates as many graphs from the front of
+		// the list as fit into the remaining time, spare threads try additional main Paulis. Paulis that are left 
+		// at the deadline are grouped qubit-wise (see applyTPBGrouper()). 
+		double timeBudget{ 0. };
+		// Number of Paulis with the largest coefficients that are each tried as main Pauli in every iteration. 
+		int numMainPaulis{ 1 };
+		// If set, receives the number of graphs that were evaluated for each collection. 
+		std::vector<size_t>* graphsEvaluated{ nullptr };
+
+		// Number of graphs evaluated per iteration (0: all). The graphs are chosen adaptively from statistics of 
+		// previous iterations (upper confidence bound on the relative collection size) plus some random exploration. 
+		int graphsPerIteration{ 0 };
+		// Seed for the random exploration of the adaptive graph selection
+		uint64_t seed{ 0 };
+
+		// Paulis with |coefficient| below this threshold are tail terms (0: none). They are left out of the search and 
+		// afterwards inserted into the finished collections with bit checks only, see insertTailPaulis(). 
+		double tailThreshold{ 0. };
+
+		// Write the state to this file every checkpointInterval seconds (empty: never), see GrouperCheckpoint.
+		// Only used by applyPauliGrouper2Multithread2(). 
+		std::string checkpointFile;
+		double checkpointInterval{ 600. };
+		// If set, continue from this state instead of starting from scratch
+		const GrouperCheckpoint* resumeFrom{ nullptr };
+
+		// If set, called with each collection (including its single-qubit layer) as soon as it is accepted. Collections 
+		// may still change afterwards through tail insertion. Only used by applyPauliGrouper2Multithread2() and 
+		// applyPauliGrouperSharded(). 
+		std::function<void(const CollectionWithGraph&)> onCollection;
+
+		// If set, solver instances for the hamiltonian's number of qubits that are used (and extended to numThreads) 
+		// instead of new ones, so that consecutive runs share them. Only used by applyPauliGrouper2Multithread2(), 
+		// applyQWCGroupMerging() and refineGrouping(). 
+		std::vector<HTCircuitFinder>* finders{ nullptr };
+
+		// If set, collections are looked up in and added to this cache (CollectionSolver::Greedy only). Only used by 
+		// applyPauliGrouper2Multithread2(). 
+		CollectionCache* collectionCache{ nullptr };
+	};
 
 
 	void computeSingleQubitLayer(CollectionWithGraph& collection, HTCircuitFinder& finder);
 	void computeSingleQubitLayer(std::vector<CollectionWithGraph>& grouping);
 
+	/// @brief Single-qubit layer for a qubit-wise commuting collection and the edgeless graph, obtained by 
+	///        lookup of the Pauli letter on each qubit (no solve needed). 
+	std::vector<BinaryCliffordGate> computeQubitWiseLayer(const std::vector<Pauli>& collection, int numQubits);
+
 
 	/// @brief Check if given pauli commutes with every other Pauli in the collection. 
 	bool commutesWithAll(const std::vector<Pauli>& collection, const Pauli& pauli);
@@ -95,5 +234,111 @@ namespace Q {
 	/// @return Sets of commuting operators
 	std::vector<CollectionWithGraph> applyPauliGrouper2Multithread(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, int numThreads = 1, bool verbose = true);
 	std::vector<CollectionWithGraph> applyPauliGrouper2Multithread2(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, int numThreads = 1, bool verbose = true);
+
+	/// @brief Same as above but configurable through @p options.
+	///
+	///        With CollectionSolver::Mip, the collection for each graph is found by a single solve that maximizes
+	///        the number (or coefficient weight) of selected Paulis instead of inserting candidates one by one.
+	///        Collections are then compared by that objective.
+	std::vector<CollectionWithGraph> applyPauliGrouper2Multithread2(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, const GrouperOptions& options);
+
+
+	/// @brief Group Paulis of given hamiltonian like applyPauliGrouper2Multithread2() but instead of testing a list of
+	///        graphs, let the solver choose the graph among all subgraphs of the connectivity. Each candidate set is
+	///        decided with a single solve, so no graphs need to be sampled. 
+	///        Only suitable for moderate numbers of qubits and connectivity edges. 
+	/// 
+	/// @param hamiltonian   Hamiltonian specification
+	/// @param connectivity  Hardware connectivity
+	/// @param maxEdgeCount  Maximum number of edges for the graphs
+	/// @param options       Options, numThreads is passed on to the solver
+	/// @return Sets of commuting operators
+	std::vector<CollectionWithGraph> applyPauliGrouperVariableGraph(const Hamiltonian& hamiltonian, const Graph<>& connectivity, int maxEdgeCount, const GrouperOptions& options);
+
+	/// @brief Group Paulis of given hamiltonian into qubit-wise commuting (TPB) collections. Gives the same collections
+	///        as applyPauliGrouper2Multithread2() with only the edgeless graph but works on the bit strings alone: 
+	///        no solver is involved and the single-qubit layer is looked up from the Pauli letter on each qubit. 
+	/// 
+	/// @param hamiltonian   Hamiltonian specification
+	/// @param verbose       If set to true, will print current status to stdout console output
+	/// @return Sets of qubit-wise commuting operators (with edgeless graphs)
+	std::vector<CollectionWithGraph> applyTPBGrouper(const Hamiltonian& hamiltonian, bool verbose = false);
+
+	/// @brief Coarse-to-fine grouping: start from the TPB grouping of applyTPBGrouper() and greedily merge whole 
+	///        qubit-wise commuting groups into hardware-tailored collections. The group with the largest leading 
+	///        coefficient is the seed, the other groups are tried in order on each graph (one solve per group and graph) 
+	///        and the largest collection is kept, the seed group with the edgeless graph if none is larger. 
+	///        Compared to applyPauliGrouper2Multithread2() the number of solves scales with the number of QWC groups 
+	///        instead of the number of Paulis. 
+	/// 
+	/// @param hamiltonian   Hamiltonian specification
+	/// @param graphs        Allowed graphs
+	/// @param options       Options, numThreads, verbose and incrementalConstraints are used
+	/// @return Sets of commuting operators
+	std::vector<CollectionWithGraph> applyQWCGroupMerging(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, const GrouperOptions& options);
+
+	/// @brief Improve a finished grouping by local search within a time budget. Single Paulis or pairs of Paulis from 
+	///        the same collection are moved to other collections (keeping their graphs) when this raises the estimated 
+	///        shot reduction, a collection that becomes empty is removed. Moves are tested by several threads in 
+	///        parallel, every accepted move is an improvement so the grouping that is returned is the best one found. 
+	///        The search ends early when no more improving moves are found. 
+	/// 
+	/// @param hamiltonian   Hamiltonian specification
+	/// @param grouping      Grouping to refine
+	/// @param timeBudget    Time budget in seconds
+	/// @param options       Options, numThreads, verbose and incrementalConstraints are used
+	/// @return Refined grouping
+	std::vector<CollectionWithGraph> refineGrouping(const Hamiltonian& hamiltonian, const std::vector<CollectionWithGraph>& grouping, double timeBudget, const GrouperOptions& options);
+
+	/// @brief Coefficient threshold such that the Paulis with |coefficient| below it make up at most the given fraction
+	///        of the summed absolute coefficients (for GrouperOptions::tailThreshold). 
+	double tailThresholdForWeightFraction(const Hamiltonian& hamiltonian, double fraction);
+
+	/// @brief Bit check whether the circuit of a collection (graph and single-qubit layer) diagonalizes a Pauli, 
+	///        which covers all Paulis in the span of the collection. Collections with the edgeless graph are checked 
+	///        qubit-wise against the union of their Paulis instead, so they also accept Paulis that need another 
+	///        layer (recompute it with computeQubitWiseLayer() after add()). 
+	class DiagonalizationCheck {
+	public:
+		DiagonalizationCheck(const CollectionWithGraph& collection, int numQubits);
+
+		bool diagonalizes(const Pauli& pauli) const;
+		/// @brief Account for a Pauli that was added to the collection (only changes edgeless collections). 
+		void add(const Pauli& pauli);
+		bool isQubitWise() const { return qubitWise; }
+
+	private:
+		using Bitstring = Pauli::Bitstring;
+
+		int numQubits{};
+		bool qubitWise{};
+		Bitstring axx{}, axz{}, azx{}, azz{};
+		std::vector<Bitstring> neighbours;
+		Bitstring xString{}, zString{};
+	};
+
+	/// @brief Insert Paulis into the collections of a finished grouping without any solves. A Pauli joins the first
+	///        collection whose circuit already diagonalizes it (see DiagonalizationCheck), the layers of edgeless 
+	///        collections are updated. The remaining Paulis are grouped qubit-wise into new collections (see 
+	///        applyTPBGrouper()). 
+	/// 
+	/// @param grouping      Collections with single-qubit layers, new collections are appended
+	/// @param paulis        Paulis to insert, visited in the given order
+	/// @param numQubits     Number of qubits
+	/// @return Number of Paulis that were inserted into existing collections
+	size_t insertTailPaulis(std::vector<CollectionWithGraph>& grouping, const std::vector<std::pair<Pauli, double>>& paulis, int numQubits);
+
+	/// @brief Largest collection for the main Pauli @p terms.front() on any of the given graphs, built by sequential
+	///        insertion of the other terms in order (one iteration of applyPauliGrouper2Multithread2() with the greedy
+	///        solver). Ties are broken in favour of the first graph. Graphs are shared among one thread per finder. 
+	/// 
+	/// @param terms                   Main Pauli followed by the remaining candidates
+	/// @param graphs                  Graphs to evaluate
+	/// @param finders                 Solver instances, at least one
+	/// @param incrementalConstraints  See GrouperOptions::incrementalConstraints
+	/// @return Index of the winning graph and its collection (without single-qubit layer), nothing if the main Pauli 
+	///         is not measurable with any of the graphs
+	std::optional<std::pair<size_t, CollectionWithGraph>> findBestCollection(const std::vector<Pauli>& terms, const std::vector<Graph<>>& graphs, std::span<HTCircuitFinder> finders, bool incrementalConstraints = false);
+
 	std::vector<CollectionWithGraph> applyPauliGrouper2Multithread3(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, int numThreads = 1, bool verbose = true);
 }
\ No newline at end of file
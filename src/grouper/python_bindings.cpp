@@ -0,0 +1,182 @@
+
+#include "pauli_grouper.h"
+#include "find_ht_circuit.h"
+#include "estimated_shot_reduction.h"
+#include "subgraph_sampling.h"
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <algorithm>
+#include <array>
+#include <format>
+#include <map>
+#include <mutex>
+#include <random>
+#include <span>
+
+namespace py = pybind11;
+using namespace Q;
+
+
+// Python module ht_grouper (built with -DPYTHON_BINDINGS=ON). Hamiltonians are passed as numpy arrays in the layout of
+// the binary hamiltonian format (see BinaryHamiltonianFormat): uint64 x-words, uint64 z-words and float64 coefficients.
+// The arrays are read in place (they need to be C-contiguous with exactly these dtypes) and the grouper runs with the
+// GIL released.
+
+
+namespace {
+
+	// Gate codes of the single-qubit layers in the returned arrays
+	constexpr std::array cliffordGates{ BinaryCliffordGates::I, BinaryCliffordGates::H, BinaryCliffordGates::S,
+		BinaryCliffordGates::SH, BinaryCliffordGates::HSH, BinaryCliffordGates::HS };
+	constexpr std::array cliffordNames{ "I", "H", "S", "SH", "HSH", "HS" };
+
+	using WordArray = py::array_t<uint64_t, py::array::c_style>;
+	using CoefficientArray = py::array_t<double, py::array::c_style>;
+
+	// Solver instances for each number of qubits, kept between calls. Calls are serialized by the mutex.
+	std::mutex findersMutex;
+	std::map<int, std::vector<HTCircuitFinder>> finders;
+
+
+	Graph<> getConnectivity(const py::object& connectivity, int numQubits) {
+		if (py::isinstance<py::str>(connectivity)) {
+			const auto type = connectivity.cast<std::string>();
+			if (type == "linear") return Graph<>::linear(numQubits);
+			if (type == "cycle") return Graph<>::cycle(numQubits);
+			if (type == "star") return Graph<>::star(numQubits);
+			throw py::value_error("The connectivity can only be \"linear\", \"cycle\", \"star\" or an array of edges");
+		}
+		const auto edges = py::array_t<int64_t, py::array::c_style | py::array::forcecast>::ensure(connectivity);
+		if (!edges || edges.ndim() != 2 || edges.shape(1) != 2) throw py::value_error("The edges of the connectivity need to be an array of shape (k, 2)");
+
+		Graph<> graph{ numQubits };
+		const auto view = edges.unchecked<2>();
+		for (py::ssize_t k = 0; k < view.shape(0); ++k) {
+			const auto i = view(k, 0);
+			const auto j = view(k, 1);
+			if (i < 0 || j < 0 || i >= numQubits || j >= numQubits || i == j) throw py::value_error(std::format("Invalid edge ({}, {}) for {} qubits", i, j, numQubits));
+			graph.addEdge(static_cast<int>(i), static_cast<int>(j));
+		}
+		return graph;
+	}
+
+
+	py::dict group(const WordArray& x, const WordArray& z, const CoefficientArray& coefficients, int numQubits, const py::object& connectivity,
+		int64_t numGraphs, int maxEdgeCount, uint64_t seed, int numThreads, int numMainPaulis, double timeBudget, double tailThreshold, bool verbose) {
+
+		if (x.ndim() != 1 || z.ndim() != 1 || coefficients.ndim() != 1 || x.shape(0) != z.shape(0) || x.shape(0) != coefficients.shape(0))
+			throw py::value_error("x, z and coefficients need to be one-dimensional arrays of the same length");
+		if (numQubits < 1 || numQubits > 64) throw py::value_error("The number of qubits needs to be between 1 and 64");
+		if (numGraphs < 1 || maxEdgeCount < 1 || numThreads < 1 || numMainPaulis < 1) throw py::value_error("numGraphs, maxEdgeCount, numThreads and numMainPaulis need to be positive");
+
+		const auto numTerms = static_cast<size_t>(x.shape(0));
+		const std::span xWords{ x.data(), numTerms };
+		const std::span zWords{ z.data(), numTerms };
+		const std::span values{ coefficients.data(), numTerms };
+		const auto mask = numQubits == 64 ? ~uint64_t{} : (uint64_t{ 1 } << numQubits) - 1;
+
+		Hamiltonian hamiltonian{ {}, numQubits };
+		hamiltonian.operators.reserve(numTerms);
+		for (size_t term = 0; term < numTerms; ++term) {
+			if ((xWords[term] | zWords[term]) & ~mask) throw py::value_error(std::format("Term {} acts on more than {} qubits", term, numQubits));
+			hamiltonian.operators.emplace_back(Pauli::FromBitstrings(numQubits, xWords[term], zWords[term]), values[term]);
+		}
+		const auto graph = getConnectivity(connectivity, numQubits);
+		if (seed == 0) seed = std::random_device{}();
+
+		std::vector<CollectionWithGraph> grouping;
+		double R_hat{};
+		size_t numSampledGraphs{};
+		{
+			py::gil_scoped_release release;
+			std::lock_guard lock{ findersMutex };
+
+			std::mt19937_64 randomGenerator{ seed };
+			auto graphs = getRandomSubgraphs(graph, numGraphs, maxEdgeCount, randomGenerator);
+			std::ranges::sort(graphs, std::less{}, &Graph<>::edgeCount);
+			numSampledGraphs = graphs.size();
+
+			const GrouperOptions options{
+				.numThreads = numThreads,
+				.verbose = verbose,
+				.timeBudget = timeBudget,
+				.numMainPaulis = numMainPaulis,
+				.seed = seed,
+				.tailThreshold = tailThreshold,
+				.finders = &finders[numQubits]
+			};
+			grouping = applyPauliGrouper2Multithread2(hamiltonian, graphs, options);
+			R_hat = estimated_shot_reduction(hamiltonian, grouping);
+		}
+
+		// Group index of each term in input order (terms may occur several times)
+		std::map<std::pair<uint64_t, uint64_t>, std::vector<size_t>> termIndices;
+		for (size_t term = numTerms; term-- > 0;) termIndices[{ xWords[term], zWords[term] }].push_back(term);
+
+		// -1 marks terms that were not assigned, which would be a bug in the grouper
+		py::array_t<int64_t> groups(static_cast<py::ssize_t>(numTerms));
+		std::fill_n(groups.mutable_data(), numTerms, int64_t{ -1 });
+		py::array_t<uint8_t> cliffords({ static_cast<py::ssize_t>(grouping.size()), static_cast<py::ssize_t>(numQubits) });
+		auto groupView = groups.mutable_unchecked<1>();
+		auto cliffordView = cliffords.mutable_unchecked<2>();
+		py::list edges;
+		for (size_t g = 0; g < grouping.size(); ++g) {
+			const auto& collection = grouping[g];
+			for (const auto& pauli : collection.paulis) {
+				auto& indices = termIndices[{ pauli.getXString(), pauli.getZString() }];
+				if (indices.empty()) throw std::runtime_error(std::format("Group {} contains {} more often than the hamiltonian", g, pauli));
+				groupView(static_cast<py::ssize_t>(indices.back())) = static_cast<int64_t>(g);
+				indices.pop_back();
+			}
+			for (int qubit = 0; qubit < numQubits; ++qubit) {
+				const auto gate = std::ranges::find(cliffordGates, collection.singleQubitLayer[qubit]);
+				cliffordView(static_cast<py::ssize_t>(g), qubit) = static_cast<uint8_t>(gate - cliffordGates.begin());
+			}
+			const auto graphEdges = collection.graph.getEdges();
+			py::array_t<int32_t> groupEdges({ static_cast<py::ssize_t>(graphEdges.size()), py::ssize_t{ 2 } });
+			auto edgeView = groupEdges.mutable_unchecked<2>();
+			for (size_t k = 0; k < graphEdges.size(); ++k) {
+				edgeView(static_cast<py::ssize_t>(k), 0) = graphEdges[k].first;
+				edgeView(static_cast<py::ssize_t>(k), 1) = graphEdges[k].second;
+			}
+			edges.append(std::move(groupEdges));
+		}
+
+		for (size_t term = 0; term < numTerms; ++term) {
+			if (groupView(static_cast<py::ssize_t>(term)) < 0) throw std::runtime_error(std::format("Term {} was not assigned to any group", term));
+		}
+
+		py::dict result;
+		result["groups"] = std::move(groups);
+		result["edges"] = std::move(edges);
+		result["cliffords"] = std::move(cliffords);
+		result["R_hat"] = R_hat;
+		result["num_graphs"] = numSampledGraphs;
+		result["seed"] = seed;
+		return result;
+	}
+}
+
+
+PYBIND11_MODULE(ht_grouper, m) {
+	m.doc() = "Grouping of Pauli operators into sets that admit hardware-tailored readout circuits";
+
+	py::tuple names(cliffordNames.size());
+	for (size_t i = 0; i < cliffordNames.size(); ++i) names[i] = cliffordNames[i];
+	m.attr("clifford_names") = names;
+
+	m.def("group", &group,
+		R"(Group a hamiltonian with the HT grouper.
+
+x, z          uint64 arrays, bit j of x[k] (z[k]) is set if term k has X or Y (Z or Y) on qubit j
+coefficients  float64 array
+connectivity  "linear", "cycle", "star" or an integer array of edges with shape (k, 2)
+
+Returns a dict with "groups" (group index of each term), "edges" (list of (k, 2) arrays with the CZ gates of each
+group), "cliffords" (uint8 array of shape (num groups, num qubits) indexing clifford_names), "R_hat", "num_graphs"
+and "seed". Solver instances are kept between calls, concurrent calls run one after another.)",
+		py::arg("x").noconvert(), py::arg("z").noconvert(), py::arg("coefficients").noconvert(), py::arg("num_qubits"),
+		py::arg("connectivity") = "linear", py::arg("num_graphs") = 100, py::arg("max_edge_count") = 1000, py::arg("seed") = 0,
+		py::arg("num_threads") = 1, py::arg("num_main_paulis") = 1, py::arg("time_budget") = 0., py::arg("tail_threshold") = 0.,
+		py::arg("verbose") = false);
+}
@@ -1,7 +1,12 @@
 ﻿#pragma once
 #include <fstream>
+#include <sstream>
+#include <limits>
+#include <algorithm>
 #include <string>
 #include "string_utility.h"
+#include "pauli_grouper.h"
+#include "baseline_groupers.h"
 
 namespace Q {
 
@@ -11,33 +16,109 @@ namespace Q {
 		using std::runtime_error::runtime_error;
 	};
 
+	/// @brief Grouping algorithm to run: the hardware-tailored grouper or one of the baselines
+	enum class GroupingAlgorithm {
+		HT,
+		HTMerge,
+		SortedInsertion,
+		LargestFirst,
+		DSatur
+	};
+
+	// Value of numGraphs that stands for all subgraphs of the connectivity
+	inline constexpr int64_t allGraphs = std::numeric_limits<int64_t>::max();
+
 	struct Configuration {
 		std::string filename;
 		std::string outfilename;
 		std::string connectivity;
 		int64_t numThreads{};
+		int64_t numProcesses{};
 		int64_t maxEdgeCount{};
 		int64_t numGraphs{};
+		int64_t maxComponentSize{};
+		ComponentShape componentShape{ ComponentShape::Any };
 		bool sortGraphsByEdgeCount{ true };
 		unsigned int seed{};
+		CollectionSolver collectionSolver{ CollectionSolver::Greedy };
+		double mipTimeLimit{};
+		bool mipWeighted{};
+		bool variableGraph{};
+		bool sortGraphsByGrayCode{};
+		bool incrementalConstraints{};
+		int64_t insertionBlockSize{};
+		bool speculativeInsertion{};
+		GroupingAlgorithm algorithm{ GroupingAlgorithm::HT };
+		Commutation commutation{ Commutation::General };
+		double refinementTime{};
+		double timeBudget{};
+		int64_t numMainPaulis{};
+		int64_t graphsPerIteration{};
+		std::string graphPrior;
+		bool graphPriorExclusive{};
+		std::string graphPriorOutput;
+		std::string streamOutfilename;
+		double tailThreshold{};
+		double tailWeightFraction{};
+		double checkpointInterval{};
+		bool resume{};
+		std::string batch;
+		// Run once for each of these numbers of graphs in increasing order (empty: single run)
+		std::vector<int64_t> numGraphsSweep;
+		// Group the hamiltonian once for each coefficient vector of this scan file (empty: single run)
+		std::string scan;
+	};
+
+
+	/// @brief One run of a batch (see readBatch()), the remaining options are taken from the configuration.
+	struct BatchJob {
+		std::string filename;
+		std::string connectivity;
+		int64_t numGraphs{};
+		unsigned int seed{};
+		std::string outfilename;
 	};
 
 
-	int64_t string_to_int(const std::string& str) {
+	/// @brief One point of a scan (see readScan()): a label (f.e. the bond length) and one coefficient per term.
+	struct ScanPoint {
+		std::string label;
+		std::vector<double> coefficients;
+	};
+
+
+	inline int64_t string_to_int(const std::string& str) {
 		try {
 			return std::stoll(str);
 		}
+		catch (std::invalid_argument& e) {
+			throw ConfigReadError(std::format("Invalid integer: \"{}\"", str));
+		}
 		catch (std::out_of_range& e) {
 			throw ConfigReadError(std::format("Integer out of range: \"{}\"", str));
 		}
 	}
 
-	Configuration readConfig(const std::string& filename) {
+	inline double string_to_double(const std::string& str) {
+		try {
+			return std::stod(str);
+		}
+		catch (std::invalid_argument& e) {
+			throw ConfigReadError(std::format("Invalid number: \"{}\"", str));
+		}
+		catch (std::out_of_range& e) {
+			throw ConfigReadError(std::format("Number out of range: \"{}\"", str));
+		}
+	}
+
+	inline Configuration readConfig(const std::string& filename) {
 
 		std::ifstream file{ filename };
 		if (!file) throw ConfigReadError(std::format("Could not open file \"{}\"", filename));
 
 		Configuration config;
+		// Boolean attributes whose default is a valid value need a flag to detect duplicates
+		bool resumeSet{};
 
 		std::string line;
 		while (std::getline(file, line)) {
@@ -69,12 +150,30 @@ namespace Q {
 				if (numThreads < 1 || numThreads > 255) throw ConfigReadError("The \"numThreads\" attribute can only take values between 1 and 255");
 				config.numThreads = numThreads;
 			}
+			else if (name == "numProcesses") {
+				if (config.numProcesses != 0) throw ConfigReadError("Duplicate attribute \"numProcesses\"");
+				auto numProcesses = string_to_int(value);
+				if (numProcesses < 1 || numProcesses > 255) throw ConfigReadError("The \"numProcesses\" attribute can only take values between 1 and 255");
+				config.numProcesses = numProcesses;
+			}
 			else if (name == "maxEdgeCount") {
 				if (config.maxEdgeCount != 0) throw ConfigReadError("Duplicate attribute \"maxEdgeCount\"");
 				auto maxEdgeCount = string_to_int(value);
 				if (maxEdgeCount < 1) throw ConfigReadError("The \"maxEdgeCount\" attribute needs to be positive");
 				config.maxEdgeCount = maxEdgeCount;
 			}
+			else if (name == "maxComponentSize") {
+				if (config.maxComponentSize != 0) throw ConfigReadError("Duplicate attribute \"maxComponentSize\"");
+				auto maxComponentSize = string_to_int(value);
+				if (maxComponentSize < 0) throw ConfigReadError("The \"maxComponentSize\" attribute cannot be negative");
+				config.maxComponentSize = maxComponentSize;
+			}
+			else if (name == "componentShape") {
+				if (value == "any") config.componentShape = ComponentShape::Any;
+				else if (value == "path") config.componentShape = ComponentShape::Path;
+				else if (value == "star") config.componentShape = ComponentShape::Star;
+				else throw ConfigReadError("The \"componentShape\" attribute can only be any, path or star");
+			}
 
 			else if (name == "numGraphs") {
 				if (config.numGraphs != 0) throw ConfigReadError("Duplicate attribute \"numGraphs\"");
@@ -95,25 +194,289 @@ namespace Q {
 				else throw ConfigReadError("The \"sortGraphsByEdgeCount\" attribute can only be true or false");
 				config.sortGraphsByEdgeCount = sortGraphsByEdgeCount;
 			}
+			else if (name == "sortGraphsByGrayCode") {
+				bool sortGraphsByGrayCode;
+				if (value == "true") sortGraphsByGrayCode = true;
+				else if (value == "false") sortGraphsByGrayCode = false;
+				else throw ConfigReadError("The \"sortGraphsByGrayCode\" attribute can only be true or false");
+				config.sortGraphsByGrayCode = sortGraphsByGrayCode;
+			}
+			else if (name == "incrementalConstraints") {
+				bool incrementalConstraints;
+				if (value == "true") incrementalConstraints = true;
+				else if (value == "false") incrementalConstraints = false;
+				else throw ConfigReadError("The \"incrementalConstraints\" attribute can only be true or false");
+				config.incrementalConstraints = incrementalConstraints;
+			}
+			else if (name == "insertionBlockSize") {
+				if (config.insertionBlockSize != 0) throw ConfigReadError("Duplicate attribute \"insertionBlockSize\"");
+				auto insertionBlockSize = string_to_int(value);
+				if (insertionBlockSize < 1) throw ConfigReadError("The \"insertionBlockSize\" attribute needs to be positive");
+				config.insertionBlockSize = insertionBlockSize;
+			}
+			else if (name == "speculativeInsertion") {
+				bool speculativeInsertion;
+				if (value == "true") speculativeInsertion = true;
+				else if (value == "false") speculativeInsertion = false;
+				else throw ConfigReadError("The \"speculativeInsertion\" attribute can only be true or false");
+				config.speculativeInsertion = speculativeInsertion;
+			}
+			else if (name == "collectionSolver") {
+				if (value == "greedy") config.collectionSolver = CollectionSolver::Greedy;
+				else if (value == "mip") config.collectionSolver = CollectionSolver::Mip;
+				else throw ConfigReadError("The \"collectionSolver\" attribute can only be greedy or mip");
+			}
+			else if (name == "mipTimeLimit") {
+				if (config.mipTimeLimit != 0) throw ConfigReadError("Duplicate attribute \"mipTimeLimit\"");
+				auto mipTimeLimit = string_to_double(value);
+				if (mipTimeLimit <= 0) throw ConfigReadError("The \"mipTimeLimit\" attribute needs to be positive");
+				config.mipTimeLimit = mipTimeLimit;
+			}
+			else if (name == "checkpointInterval") {
+				if (config.checkpointInterval != 0) throw ConfigReadError("Duplicate attribute \"checkpointInterval\"");
+				auto checkpointInterval = string_to_double(value);
+				if (checkpointInterval < 0) throw ConfigReadError("The \"checkpointInterval\" attribute cannot be negative");
+				config.checkpointInterval = checkpointInterval;
+			}
+			else if (name == "resume") {
+				if (resumeSet) throw ConfigReadError("Duplicate attribute \"resume\"");
+				resumeSet = true;
+				bool resume;
+				if (value == "true") resume = true;
+				else if (value == "false") resume = false;
+				else throw ConfigReadError("The \"resume\" attribute can only be true or false");
+				config.resume = resume;
+			}
+			else if (name == "refinementTime") {
+				if (config.refinementTime != 0) throw ConfigReadError("Duplicate attribute \"refinementTime\"");
+				auto refinementTime = string_to_double(value);
+				if (refinementTime < 0) throw ConfigReadError("The \"refinementTime\" attribute cannot be negative");
+				config.refinementTime = refinementTime;
+			}
+			else if (name == "timeBudget") {
+				if (config.timeBudget != 0) throw ConfigReadError("Duplicate attribute \"timeBudget\"");
+				auto timeBudget = string_to_double(value);
+				if (timeBudget < 0) throw ConfigReadError("The \"timeBudget\" attribute cannot be negative");
+				config.timeBudget = timeBudget;
+			}
+			else if (name == "tailThreshold") {
+				if (config.tailThreshold != 0) throw ConfigReadError("Duplicate attribute \"tailThreshold\"");
+				auto tailThreshold = string_to_double(value);
+				if (tailThreshold < 0) throw ConfigReadError("The \"tailThreshold\" attribute cannot be negative");
+				config.tailThreshold = tailThreshold;
+			}
+			else if (name == "tailWeightFraction") {
+				if (config.tailWeightFraction != 0) throw ConfigReadError("Duplicate attribute \"tailWeightFraction\"");
+				auto tailWeightFraction = string_to_double(value);
+				if (tailWeightFraction < 0 || tailWeightFraction >= 1) throw ConfigReadError("The \"tailWeightFraction\" attribute needs to be in [0, 1)");
+				config.tailWeightFraction = tailWeightFraction;
+			}
+			else if (name == "numMainPaulis") {
+				if (config.numMainPaulis != 0) throw ConfigReadError("Duplicate attribute \"numMainPaulis\"");
+				auto numMainPaulis = string_to_int(value);
+				if (numMainPaulis < 1) throw ConfigReadError("The \"numMainPaulis\" attribute needs to be positive");
+				config.numMainPaulis = numMainPaulis;
+			}
+			else if (name == "graphsPerIteration") {
+				if (config.graphsPerIteration != 0) throw ConfigReadError("Duplicate attribute \"graphsPerIteration\"");
+				auto graphsPerIteration = string_to_int(value);
+				if (graphsPerIteration < 0) throw ConfigReadError("The \"graphsPerIteration\" attribute cannot be negative");
+				config.graphsPerIteration = graphsPerIteration;
+			}
+			else if (name == "graphPrior") {
+				if (config.graphPrior != "") throw ConfigReadError("Duplicate attribute \"graphPrior\"");
+				config.graphPrior = value;
+			}
+			else if (name == "graphPriorMode") {
+				if (value == "first") config.graphPriorExclusive = false;
+				else if (value == "exclusive") config.graphPriorExclusive = true;
+				else throw ConfigReadError("The \"graphPriorMode\" attribute can only be first or exclusive");
+			}
+			else if (name == "graphPriorOutput") {
+				if (config.graphPriorOutput != "") throw ConfigReadError("Duplicate attribute \"graphPriorOutput\"");
+				config.graphPriorOutput = value;
+			}
+			else if (name == "batch") {
+				if (config.batch != "") throw ConfigReadError("Duplicate attribute \"batch\"");
+				config.batch = value;
+			}
+			else if (name == "numGraphsSweep") {
+				if (!config.numGraphsSweep.empty()) throw ConfigReadError("Duplicate attribute \"numGraphsSweep\"");
+				if (value == "") continue;
+				for (const auto& entry : split(value, ',')) {
+					const auto setting = trim(entry, " \t");
+					const auto numGraphs = setting == "all" ? allGraphs : string_to_int(setting);
+					if (numGraphs < 1) throw ConfigReadError("The \"numGraphsSweep\" attribute needs to be a list of positive numbers or all");
+					config.numGraphsSweep.push_back(numGraphs);
+				}
+				std::ranges::sort(config.numGraphsSweep);
+				config.numGraphsSweep.erase(std::ranges::unique(config.numGraphsSweep).begin(), config.numGraphsSweep.end());
+			}
+			else if (name == "scan") {
+				if (config.scan != "") throw ConfigReadError("Duplicate attribute \"scan\"");
+				config.scan = value;
+			}
+			else if (name == "streamOutfilename") {
+				if (config.streamOutfilename != "") throw ConfigReadError("Duplicate attribute \"streamOutfilename\"");
+				config.streamOutfilename = value;
+			}
+			else if (name == "mipObjective") {
+				if (value == "count") config.mipWeighted = false;
+				else if (value == "weight") config.mipWeighted = true;
+				else throw ConfigReadError("The \"mipObjective\" attribute can only be count or weight");
+			}
+			else if (name == "graphSelection") {
+				if (value == "sampled") config.variableGraph = false;
+				else if (value == "variable") config.variableGraph = true;
+				else throw ConfigReadError("The \"graphSelection\" attribute can only be sampled or variable");
+			}
+			else if (name == "algorithm") {
+				if (value == "ht") config.algorithm = GroupingAlgorithm::HT;
+				else if (value == "htMerge") config.algorithm = GroupingAlgorithm::HTMerge;
+				else if (value == "sortedInsertion") config.algorithm = GroupingAlgorithm::SortedInsertion;
+				else if (value == "largestFirst") config.algorithm = GroupingAlgorithm::LargestFirst;
+				else if (value == "dsatur") config.algorithm = GroupingAlgorithm::DSatur;
+				else throw ConfigReadError("The \"algorithm\" attribute can only be ht, htMerge, sortedInsertion, largestFirst or dsatur");
+			}
+			else if (name == "commutation") {
+				if (value == "general") config.commutation = Commutation::General;
+				else if (value == "qubitwise") config.commutation = Commutation::QubitWise;
+				else throw ConfigReadError("The \"commutation\" attribute can only be general or qubitwise");
+			}
 			else {
 				throw ConfigReadError(std::format("Unknown attribute \"{}\"", name));
 			}
 		}
 
-		if (config.filename == "")
+		// In batch mode, these are given for each job
+		if (config.filename == "" && config.batch == "")
 			throw ConfigReadError("No [filename] specified");
-		if (config.outfilename == "")
+		if (config.outfilename == "" && config.batch == "")
 			throw ConfigReadError("No [outfilename] specified");
-		if (config.connectivity == "")
+		if (config.connectivity == "" && config.batch == "")
 			throw ConfigReadError("No [connectivity] specified");
+		if (!config.numGraphsSweep.empty() && config.batch != "")
+			throw ConfigReadError("The \"numGraphsSweep\" and \"batch\" attributes cannot be combined");
+		// htMerge would not reuse anything between the settings (see CollectionCache)
+		if (!config.numGraphsSweep.empty() && (config.variableGraph || config.algorithm != GroupingAlgorithm::HT))
+			throw ConfigReadError("The \"numGraphsSweep\" attribute needs sampled graphs and the ht algorithm");
+		if (config.scan != "" && (config.batch != "" || !config.numGraphsSweep.empty()))
+			throw ConfigReadError("The \"scan\" attribute cannot be combined with \"batch\" or \"numGraphsSweep\"");
+		if (config.scan != "" && (config.variableGraph || config.algorithm != GroupingAlgorithm::HT))
+			throw ConfigReadError("The \"scan\" attribute needs sampled graphs and the ht algorithm");
+		if ((config.tailThreshold > 0 || config.tailWeightFraction > 0) && (config.variableGraph || config.algorithm != GroupingAlgorithm::HT))
+			throw ConfigReadError("The \"tailThreshold\" and \"tailWeightFraction\" attributes need sampled graphs and the ht algorithm");
+		if ((config.checkpointInterval > 0 || config.resume) && (config.variableGraph || config.algorithm != GroupingAlgorithm::HT || config.scan != ""))
+			throw ConfigReadError("The \"checkpointInterval\" and \"resume\" attributes need sampled graphs and the ht algorithm and cannot be combined with \"scan\"");
+		if (config.numProcesses > 1) {
+			// The sharded grouper only runs the sequential greedy insertion on sampled graphs
+			if (config.variableGraph || config.algorithm != GroupingAlgorithm::HT)
+				throw ConfigReadError("The \"numProcesses\" attribute needs sampled graphs and the ht algorithm");
+			const std::pair<bool, const char*> unsupported[] = {
+				{ config.collectionSolver != CollectionSolver::Greedy, "collectionSolver" },
+				{ config.insertionBlockSize > 1, "insertionBlockSize" },
+				{ config.speculativeInsertion, "speculativeInsertion" },
+				{ config.timeBudget > 0, "timeBudget" },
+				{ config.numMainPaulis > 1, "numMainPaulis" },
+				{ config.graphsPerIteration > 0, "graphsPerIteration" },
+				{ config.checkpointInterval > 0, "checkpointInterval" },
+				{ config.resume, "resume" },
+				{ !config.numGraphsSweep.empty(), "numGraphsSweep" },
+				{ config.scan != "", "scan" },
+			};
+			for (const auto& [isSet, name] : unsupported) {
+				if (isSet) throw ConfigReadError(std::format("The \"{}\" attribute cannot be combined with \"numProcesses\" greater than 1", name));
+			}
+		}
+		// Without a prior, the exclusive mode would leave no graphs and the run would degrade to qubit-wise grouping
+		if (config.graphPriorExclusive && config.graphPrior == "")
+			throw ConfigReadError("The \"graphPriorMode\" attribute exclusive needs a \"graphPrior\"");
 		if (config.numGraphs == 0) config.numGraphs = 100;
 		if (config.maxEdgeCount == 0) config.maxEdgeCount = 1000;
 		if (config.numThreads == 0) config.numThreads = 1;
+		if (config.numProcesses == 0) config.numProcesses = 1;
+		if (config.mipTimeLimit == 0) config.mipTimeLimit = 10;
+		if (config.insertionBlockSize == 0) config.insertionBlockSize = 1;
+		if (config.numMainPaulis == 0) config.numMainPaulis = 1;
 
 		return config;
 	}
 
 
+	/// @brief Read a batch file with one job per line: 
+	/// 
+	///            <filename> <connectivity> <numGraphs> <seed> <outfilename>
+	/// 
+	///        where numGraphs may be "default" to use the value of the configuration and seed 0 means random. 
+	///        Everything after a "#" is a comment. 
+	inline std::vector<BatchJob> readBatch(const std::string& filename, const Configuration& config) {
+
+		std::ifstream file{ filename };
+		if (!file) throw ConfigReadError(std::format("Could not open file \"{}\"", filename));
+
+		std::vector<BatchJob> jobs;
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.empty()) continue;
+			line = trim(split(line, '#')[0], " \t"); // strip comments and whitespace
+			if (line.empty()) continue;
+
+			std::istringstream stream{ line };
+			std::vector<std::string> entries;
+			for (std::string entry; stream >> entry;) entries.push_back(entry);
+			if (entries.size() != 5) throw ConfigReadError(std::format("Invalid batch job \"{}\". Expected <filename> <connectivity> <numGraphs> <seed> <outfilename>", line));
+
+			BatchJob job{ .filename = entries[0], .connectivity = entries[1], .numGraphs = config.numGraphs, .outfilename = entries[4] };
+			if (entries[2] != "default") {
+				job.numGraphs = string_to_int(entries[2]);
+				if (job.numGraphs < 1) throw ConfigReadError(std::format("The number of graphs needs to be positive in batch job \"{}\"", line));
+			}
+			const auto seed = string_to_int(entries[3]);
+			if (seed < 0 || seed > std::numeric_limits<unsigned int>::max()) throw ConfigReadError(std::format("Invalid seed in batch job \"{}\"", line));
+			job.seed = static_cast<unsigned int>(seed);
+			jobs.push_back(std::move(job));
+		}
+		if (jobs.empty()) throw ConfigReadError(std::format("The batch file \"{}\" contains no jobs", filename));
+		return jobs;
+	}
+
+
+	/// @brief Read a scan file with one point per line: 
+	/// 
+	///            <label> <coefficient 1> ... <coefficient numTerms>
+	/// 
+	///        with the coefficients in the order of the terms of the hamiltonian file. Everything after a "#" is a comment. 
+	inline std::vector<ScanPoint> readScan(const std::string& filename, size_t numTerms) {
+
+		std::ifstream file{ filename };
+		if (!file) throw ConfigReadError(std::format("Could not open file \"{}\"", filename));
+
+		std::vector<ScanPoint> points;
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.empty()) continue;
+			line = trim(split(line, '#')[0], " \t"); // strip comments and whitespace
+			if (line.empty()) continue;
+
+			std::istringstream stream{ line };
+			ScanPoint point;
+			stream >> point.label;
+			// Labels become part of output filenames
+			if (point.label.find_first_of("/\\") != std::string::npos || point.label.find("..") != std::string::npos)
+				throw ConfigReadError(std::format("Scan label \"{}\" must not contain path separators or \"..\"", point.label));
+			if (std::ranges::find(points, point.label, &ScanPoint::label) != points.end())
+				throw ConfigReadError(std::format("Duplicate scan label \"{}\"", point.label));
+			point.coefficients.reserve(numTerms);
+			for (std::string entry; stream >> entry;) point.coefficients.push_back(string_to_double(entry));
+			if (point.coefficients.size() != numTerms) 
+				throw ConfigReadError(std::format("Scan point \"{}\" has {} coefficients, the hamiltonian has {} terms", point.label, point.coefficients.size(), numTerms));
+			points.push_back(std::move(point));
+		}
+		if (points.empty()) throw ConfigReadError(std::format("The scan file \"{}\" contains no points", filename));
+		return points;
+	}
+
+
 	class ConnectivityError : public std::runtime_error {
 	public:
 		using std::runtime_error::runtime_error;
@@ -148,7 +511,7 @@ namespace Q {
 		AdjacencyMatrix adjacencyMatrix;
 	};
 
-	Connectivity readConnectivity(const std::string& filename) {
+	inline Connectivity readConnectivity(const std::string& filename) {
 
 		std::ifstream file{ filename };
 		if (!file) throw ConnectivityError(std::format("Could not open file \"{}\"", filename));
@@ -6,6 +6,18 @@
 #include "binary_pauli.h"
 #include "string_utility.h"
 #include "hamiltonian.h"
+#include <algorithm>
+#include <charconv>
+#include <optional>
+#include <string_view>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace Q {
 
@@ -13,7 +25,7 @@ namespace Q {
 	/// @brief Read hamiltonians from python file in form of a dictionary
 	/// @param filename Path to file
 	/// @return List of hamiltonian specifications
-	std::vector<Hamiltonian> readHamiltonians(const std::string& filename) {
+	inline std::vector<Hamiltonian> readHamiltonians(const std::string& filename) {
 
 		std::ifstream file{ filename };
 		if (!file) throw std::runtime_error(std::format("Error, could not open file {}", filename));
@@ -62,51 +74,205 @@ namespace Q {
 		using std::runtime_error::runtime_error;
 	};
 
-	/// @brief Read hamiltonians from python file in form of a dictionary
-	/// @param filename Path to file
-	/// @return List of hamiltonian specifications
-	Hamiltonian readHamiltonianFromJson(const std::string& filename) {
+	/// @brief Read-only view of a whole file. The file is memory-mapped on POSIX systems and read into memory 
+	///        at once elsewhere. 
+	class MappedFile {
+	public:
+		explicit MappedFile(const std::string& filename) {
+#ifndef _WIN32
+			const int fd = ::open(filename.c_str(), O_RDONLY);
+			if (fd < 0) throw ReadHamiltonianError(std::format("Error, could not open file {}", filename));
+			struct stat info {};
+			if (::fstat(fd, &info) != 0) {
+				::close(fd);
+				throw ReadHamiltonianError(std::format("Error, could not read file {}", filename));
+			}
+			size = static_cast<size_t>(info.st_size);
+			if (size > 0) {
+				void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (address == MAP_FAILED) {
+					::close(fd);
+					throw ReadHamiltonianError(std::format("Error, could not map file {}", filename));
+				}
+				data = static_cast<const char*>(address);
+			}
+			::close(fd);
+#else
+			std::ifstream file{ filename, std::ios::binary };
+			if (!file) throw ReadHamiltonianError(std::format("Error, could not open file {}", filename));
+			buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			data = buffer.data();
+			size = buffer.size();
+#endif
+		}
 
-		std::ifstream file{ filename };
-		if (!file) throw ReadHamiltonianError(std::format("Error, could not open file {}", filename));
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
 
-		Hamiltonian hamiltonian;
+		~MappedFile() {
+#ifndef _WIN32
+			if (data) ::munmap(const_cast<char*>(data), size);
+#endif
+		}
 
-		std::string line;
-		int lineIndex{ 0 };
-		while (std::getline(file, line)) {
-			++lineIndex;
-			if (line.empty()) continue;
-			line = trim(line, " \t{}");
-			if (line.empty()) continue;
+		std::string_view view() const { return { data, size }; }
 
-			auto components = split(line, ':');
-			if (components.size() != 2) throw ReadHamiltonianError(std::format("Invalid format for \"{}\" at line {}", line, lineIndex));
+	private:
+		const char* data{};
+		size_t size{};
+#ifdef _WIN32
+		std::string buffer;
+#endif
+	};
 
-			auto pauliString = trim(components[0], " \t\"\'");
-			auto value = trim(components[1], " \t,");
 
-			if (pauliString.size() == 0) throw ReadHamiltonianError(std::format("Empty Pauli string at line {}", lineIndex));
-			if (pauliString.size() > 64) throw ReadHamiltonianError(std::format("Paulis with more than 64 qubits are currently not supported"));
+	namespace HamiltonianParsing {
+
+		constexpr bool isWhitespace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+		// Terms of one chunk of the dictionary together with the first error (as offset into the text)
+		struct Chunk {
+			std::vector<std::pair<Pauli, double>> operators;
+			int numQubits{};
+			size_t firstEntryOffset{};
+			std::optional<std::pair<size_t, std::string>> error;
+		};
+
+		/// @brief Parse the entries "<pauli>": <coefficient> separated by commas in text[begin, end). Keys may also be
+		///        in single quotes (as written by Python's str() of a dictionary). 
+		inline void parseEntries(std::string_view text, size_t begin, size_t end, Chunk& chunk) {
+			size_t p = begin;
+			auto skipWhitespace = [&] { while (p < end && isWhitespace(text[p])) ++p; };
+			auto fail = [&](size_t offset, std::string message) { chunk.error.emplace(offset, std::move(message)); };
+
+			while (true) {
+				skipWhitespace();
+				const auto entryOffset = p;
+				if (p == end || (text[p] != '"' && text[p] != '\'')) return fail(p, "Expected a Pauli string in quotes");
+				const char quote = text[p];
+				const auto keyStart = ++p;
+				while (p < end && text[p] != quote) {
+					if (text[p] == '\\') return fail(p, "Escape sequences are not supported in Pauli strings");
+					if (text[p] == '\n') return fail(p, "Unterminated string");
+					++p;
+				}
+				if (p == end) return fail(keyStart - 1, "Unterminated string");
+				const auto pauliString = text.substr(keyStart, p - keyStart);
+				++p;
+
+				// Optional phase followed by the Pauli letters
+				size_t letters = pauliString.starts_with("-i") ? 2 : pauliString.starts_with('-') || pauliString.starts_with('i') ? 1 : 0;
+				if (pauliString.size() == letters) return fail(keyStart, "Empty Pauli string");
+				for (auto i = letters; i < pauliString.size(); ++i) {
+					const char c = pauliString[i];
+					if (c != 'I' && c != 'X' && c != 'Y' && c != 'Z') return fail(keyStart + i, std::format("Invalid character '{}' in Pauli string", c));
+				}
+				if (pauliString.size() - letters > 64) return fail(keyStart, "Paulis with more than 64 qubits are currently not supported");
 
-			Pauli pauli{ pauliString };
-			if (hamiltonian.numQubits == 0) {
-				hamiltonian.numQubits = pauli.numQubits();
-			}
-			else if (hamiltonian.numQubits != pauli.numQubits()) {
-				throw ReadHamiltonianError(std::format("The Pauli {} at line {} does not have the same number of qubits as the preceding Paulis", pauliString, lineIndex));
+				Pauli pauli{ pauliString };
+				if (chunk.numQubits == 0) {
+					chunk.numQubits = pauli.numQubits();
+					chunk.firstEntryOffset = entryOffset;
+				}
+				else if (chunk.numQubits != pauli.numQubits()) {
+					return fail(entryOffset, std::format("The Pauli {} does not have the same number of qubits as the preceding Paulis", pauliString));
+				}
+
+				skipWhitespace();
+				if (p == end || text[p] != ':') return fail(p, "Expected ':'");
+				++p;
+				skipWhitespace();
+
+				// from_chars would also accept inf and nan
+				if (p == end || (text[p] != '-' && (text[p] < '0' || text[p] > '9'))) return fail(p, "Invalid coefficient");
+				double coefficient{};
+				const auto [next, ec] = std::from_chars(text.data() + p, text.data() + end, coefficient);
+				if (ec == std::errc::invalid_argument) return fail(p, "Invalid coefficient");
+				if (ec == std::errc::result_out_of_range) return fail(p, "Out of range coefficient");
+				p = static_cast<size_t>(next - text.data());
+				chunk.operators.emplace_back(pauli, coefficient);
+
+				skipWhitespace();
+				if (p == end) return;
+				if (text[p] != ',') return fail(p, "Expected ',' or '}'");
+				++p;
 			}
+		}
+	}
+
+
+	/// @brief Read a hamiltonian from a JSON file with a dictionary of Pauli strings and coefficients, f.e. 
+	///        {"XXI": 0.5, "IZZ": -1.2}. Any JSON layout is accepted. The file is memory-mapped and large files are 
+	///        split at commas into chunks that are parsed in parallel. Errors report the line and column. 
+	/// @param filename Path to file
+	/// @return Hamiltonian specification
+	inline Hamiltonian readHamiltonianFromJson(const std::string& filename) {
+		using namespace HamiltonianParsing;
+
+		MappedFile file{ filename };
+		const auto text = file.view();
+
+		auto error = [&](size_t offset, std::string_view message) {
+			offset = std::min(offset, text.size());
+			const auto line = std::ranges::count(text.substr(0, offset), '\n') + 1;
+			const auto lineStart = text.substr(0, offset).rfind('\n');
+			const auto column = offset - (lineStart == std::string_view::npos ? 0 : lineStart + 1) + 1;
+			return ReadHamiltonianError(std::format("{} at line {}, column {} of {}", message, line, column, filename));
+		};
+
+		size_t begin = text.starts_with("\xEF\xBB\xBF") ? 3 : 0; // UTF-8 byte order mark
+		while (begin < text.size() && isWhitespace(text[begin])) ++begin;
+		if (begin == text.size() || text[begin] != '{') throw error(begin, "Expected '{'");
+		++begin;
+		size_t end = text.size();
+		while (end > begin && isWhitespace(text[end - 1])) --end;
+		if (end == begin || text[end - 1] != '}') throw error(end, "Expected '}' at the end of the file");
+		--end;
 
-			try {
-				auto coefficient = std::stod(value);
-				hamiltonian.operators.emplace_back(pauli, coefficient);
+		Hamiltonian hamiltonian;
+		if (std::all_of(text.begin() + begin, text.begin() + end, isWhitespace)) return hamiltonian;
+
+		// Split into chunks of at least 1 MB at commas outside of strings
+		constexpr size_t minChunkSize = 1 << 20;
+		const auto numChunks = std::clamp<size_t>((end - begin) / minChunkSize, 1, std::max(std::thread::hardware_concurrency(), 1u));
+		std::vector<std::pair<size_t, size_t>> ranges;
+		size_t chunkBegin = begin;
+		for (size_t k = 1; k < numChunks; ++k) {
+			auto position = std::max(begin + (end - begin) * k / numChunks, chunkBegin);
+			size_t comma = std::string_view::npos;
+			while ((comma = text.find(',', position)) < end) {
+				if (std::count(text.begin() + chunkBegin, text.begin() + comma, '"') % 2 == 0) break;
+				position = comma + 1;
 			}
-			catch (std::invalid_argument&) {
-				throw ReadHamiltonianError(std::format("Invalid coefficient {} at line {}", value, lineIndex));
+			if (comma >= end) break;
+			ranges.emplace_back(chunkBegin, comma);
+			chunkBegin = comma + 1;
+		}
+		ranges.emplace_back(chunkBegin, end);
+
+		std::vector<Chunk> chunks(ranges.size());
+		{
+			std::vector<std::jthread> workers;
+			for (size_t i = 1; i < ranges.size(); ++i) {
+				workers.emplace_back([&, i] { parseEntries(text, ranges[i].first, ranges[i].second, chunks[i]); });
 			}
-			catch (std::out_of_range&) {
-				throw ReadHamiltonianError(std::format("Out of range coefficient {} at line {}", value, lineIndex));
+			parseEntries(text, ranges[0].first, ranges[0].second, chunks[0]);
+		}
+
+		size_t numOperators{};
+		for (const auto& chunk : chunks) numOperators += chunk.operators.size();
+		hamiltonian.operators.reserve(numOperators);
+		for (auto& chunk : chunks) {
+			if (!chunk.operators.empty()) {
+				if (hamiltonian.numQubits == 0) {
+					hamiltonian.numQubits = chunk.numQubits;
+				}
+				else if (hamiltonian.numQubits != chunk.numQubits) {
+					throw error(chunk.firstEntryOffset, "The Pauli does not have the same number of qubits as the preceding Paulis");
+				}
 			}
+			if (chunk.error) throw error(chunk.error->first, chunk.error->second);
+			std::ranges::move(chunk.operators, std::back_inserter(hamiltonian.operators));
 		}
 		return hamiltonian;
 	}
@@ -120,7 +286,7 @@ namespace Q {
 	///        ...
 	/// @param filename Path to file
 	/// @return List of Pauli groups
-	std::vector<std::vector<Pauli>> readPauliGroups(const std::string& filename) {
+	inline std::vector<std::vector<Pauli>> readPauliGroups(const std::string& filename) {
 
 		std::ifstream file{ filename };
 		if (!file) throw std::runtime_error(std::format("Error, could not open file {}", filename));
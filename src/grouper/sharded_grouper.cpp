@@ -0,0 +1,287 @@
+
+#include "sharded_grouper.h"
+#include "find_ht_circuit.h"
+#include <algorithm>
+#include <ranges>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <csignal>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+
+using namespace Q;
+
+
+#ifndef _WIN32
+
+namespace {
+
+	// Messages over the pipes are a count followed by that many uint64_t values.
+
+	bool writeAll(int fd, const void* data, size_t size) {
+		auto bytes = static_cast<const char*>(data);
+		while (size > 0) {
+			const auto written = ::write(fd, bytes, size);
+			if (written < 0 && errno == EINTR) continue;
+			if (written <= 0) return false;
+			bytes += written;
+			size -= static_cast<size_t>(written);
+		}
+		return true;
+	}
+
+	bool readAll(int fd, void* data, size_t size) {
+		auto bytes = static_cast<char*>(data);
+		while (size > 0) {
+			const auto numRead = ::read(fd, bytes, size);
+			if (numRead < 0 && errno == EINTR) continue;
+			if (numRead <= 0) return false;
+			bytes += numRead;
+			size -= static_cast<size_t>(numRead);
+		}
+		return true;
+	}
+
+	bool writeMessage(int fd, const std::vector<uint64_t>& values) {
+		const uint64_t count = values.size();
+		return writeAll(fd, &count, sizeof(count)) && writeAll(fd, values.data(), count * sizeof(uint64_t));
+	}
+
+	std::optional<std::vector<uint64_t>> readMessage(int fd) {
+		uint64_t count{};
+		if (!readAll(fd, &count, sizeof(count))) return std::nullopt;
+		std::vector<uint64_t> values(count);
+		if (!readAll(fd, values.data(), count * sizeof(uint64_t))) return std::nullopt;
+		return values;
+	}
+
+	struct Worker {
+		pid_t pid{};
+		int requestFd{ -1 };
+		int responseFd{ -1 };
+		size_t numGraphs{};
+		bool alive{ true };
+	};
+
+	/// @brief Graph indices [first, last) of a shard. Shards are contiguous so that each worker walks a segment of
+	///        the Gray-code order of the graphs. 
+	std::pair<size_t, size_t> shardRange(size_t numGraphs, size_t shard, size_t numShards) {
+		return { numGraphs * shard / numShards, numGraphs * (shard + 1) / numShards };
+	}
+
+	/// @brief Main loop of a worker process. A request holds the indices of the remaining terms (main Pauli first),
+	///        the response holds the global index of the best graph of the shard followed by the term indices of its
+	///        collection, or is empty if no graph of the shard measures the main Pauli. An empty request ends the worker.
+	[[noreturn]] void runWorker(const std::vector<Pauli>& terms, const std::vector<Graph<>>& graphs, size_t shard, size_t numShards,
+		int numQubits, const GrouperOptions& options, int requestFd, int responseFd) {
+		int exitCode = 0;
+		try {
+			const auto [firstGraph, lastGraph] = shardRange(graphs.size(), shard, numShards);
+			const std::vector<Graph<>> shardGraphs(graphs.begin() + firstGraph, graphs.begin() + lastGraph);
+			std::vector<HTCircuitFinder> finders;
+			for (int i = 0; i < std::max(options.numThreads, 1); ++i) finders.emplace_back(numQubits);
+
+			while (auto request = readMessage(requestFd)) {
+				if (request->empty()) break;
+
+				std::vector<Pauli> remaining;
+				for (auto index : *request) remaining.push_back(terms[index]);
+
+				std::vector<uint64_t> response;
+				if (auto best = findBestCollection(remaining, shardGraphs, finders, options.incrementalConstraints)) {
+					response.push_back(firstGraph + best->first);
+					// The collection is a subsequence of the remaining terms
+					size_t position = 0;
+					for (const auto& pauli : best->second.paulis) {
+						while (remaining[position] != pauli) ++position;
+						response.push_back((*request)[position]);
+					}
+				}
+				if (!writeMessage(responseFd, response)) break;
+			}
+		}
+		catch (...) {
+			exitCode = 1;
+		}
+		::close(requestFd);
+		::close(responseFd);
+		// Skip destructors and stdout buffers inherited from the coordinator
+		::_exit(exitCode);
+	}
+
+	void stopWorker(Worker& worker, bool kill) {
+		if (kill) ::kill(worker.pid, SIGKILL);
+		::close(worker.requestFd);
+		::close(worker.responseFd);
+		::waitpid(worker.pid, nullptr, 0);
+		worker.alive = false;
+	}
+
+	/// @brief Worker processes of a run together with the SIGPIPE handler of the coordinator. If the run ends early
+	///        (f.e. through an exception), the workers that are still running are killed and the handler is restored. 
+	struct WorkerPool {
+		std::vector<Worker> workers;
+		// Writing to a worker that died must not kill the coordinator
+		decltype(SIG_IGN) previousHandler{ std::signal(SIGPIPE, SIG_IGN) };
+
+		WorkerPool() = default;
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		~WorkerPool() {
+			for (auto& worker : workers) {
+				if (worker.alive) stopWorker(worker, true);
+			}
+			std::signal(SIGPIPE, previousHandler);
+		}
+	};
+}
+
+#endif
+
+
+std::vector<CollectionWithGraph> Q::applyPauliGrouperSharded(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, int numProcesses, const GrouperOptions& options) {
+#ifdef _WIN32
+	throw std::runtime_error("Grouping with several processes is only supported on POSIX systems");
+#else
+	const auto verbose = options.verbose;
+	const auto numQubits = hamiltonian.numQubits;
+
+	auto sortedTerms = hamiltonian.operators;
+	// Sort by magnitude in descending order
+	std::ranges::sort(sortedTerms, [](const auto& a, const auto& b) {return std::abs(a.second) > std::abs(b.second); });
+
+	// Tail terms are left out of the search and inserted at the end (see GrouperOptions::tailThreshold)
+	const auto firstTailTerm = std::ranges::find_if(sortedTerms, [&](const auto& a) { return std::abs(a.second) < options.tailThreshold; });
+	const std::vector<std::pair<Pauli, double>> tail(firstTailTerm, sortedTerms.end());
+	sortedTerms.erase(firstTailTerm, sortedTerms.end());
+
+	std::vector<Pauli> terms;
+	for (const auto& [pauli, _] : sortedTerms) terms.push_back(pauli);
+
+	std::vector<CollectionWithGraph> collections;
+	if (!terms.empty()) {
+		const auto numShards = static_cast<size_t>(std::max(numProcesses, 1));
+
+		std::cout.flush();
+		std::fflush(stdout);
+
+		WorkerPool pool;
+		auto& workers = pool.workers;
+		for (size_t shard = 0; shard < numShards; ++shard) {
+			int requestPipe[2];
+			int responsePipe[2];
+			if (::pipe(requestPipe) != 0) throw std::runtime_error("Could not create pipe for worker process");
+			if (::pipe(responsePipe) != 0) {
+				::close(requestPipe[0]);
+				::close(requestPipe[1]);
+				throw std::runtime_error("Could not create pipe for worker process");
+			}
+			const auto pid = ::fork();
+			if (pid < 0) throw std::runtime_error("Could not start worker process");
+			if (pid == 0) {
+				// Pipes of the workers started before are not needed here
+				for (const auto& worker : workers) {
+					::close(worker.requestFd);
+					::close(worker.responseFd);
+				}
+				::close(requestPipe[1]);
+				::close(responsePipe[0]);
+				runWorker(terms, graphs, shard, numShards, numQubits, options, requestPipe[0], responsePipe[1]);
+			}
+			::close(requestPipe[0]);
+			::close(responsePipe[1]);
+			const auto [firstGraph, lastGraph] = shardRange(graphs.size(), shard, numShards);
+			workers.push_back({ pid, requestPipe[1], responsePipe[0], lastGraph - firstGraph });
+		}
+		if (verbose) println("Started {} worker processes\n", numShards);
+
+		// Only needed for the single-qubit layers of the selected collections
+		HTCircuitFinder finder{ numQubits };
+
+		std::vector<uint64_t> remaining(terms.size());
+		std::iota(remaining.begin(), remaining.end(), 0);
+
+		while (!remaining.empty()) {
+			for (auto& worker : workers) {
+				if (worker.alive && !writeMessage(worker.requestFd, remaining)) {
+					println("Worker process {} stopped unexpectedly, continuing without its {} graphs", worker.pid, worker.numGraphs);
+					stopWorker(worker, true);
+				}
+			}
+
+			// The qubit-wise collection of the main Pauli comes first in the comparison
+			std::vector<uint64_t> best{ remaining.front() };
+			std::vector<Pauli> tpbCollection{ terms[remaining.front()] };
+			for (auto index : remaining | std::ranges::views::drop(1)) {
+				if (qubitwiseCommutesWithAll(tpbCollection, terms[index])) {
+					tpbCollection.push_back(terms[index]);
+					best.push_back(index);
+				}
+			}
+			std::optional<size_t> bestGraph;
+			size_t numGraphsEvaluated{};
+
+			for (auto& worker : workers) {
+				if (!worker.alive) continue;
+				auto response = readMessage(worker.responseFd);
+				if (!response) {
+					println("Worker process {} stopped unexpectedly, continuing without its {} graphs", worker.pid, worker.numGraphs);
+					stopWorker(worker, true);
+					continue;
+				}
+				numGraphsEvaluated += worker.numGraphs;
+				if (response->empty()) continue;
+
+				const auto graphIndex = static_cast<size_t>(response->front());
+				const auto size = response->size() - 1;
+				if (size > best.size() || (size == best.size() && bestGraph && graphIndex < *bestGraph)) {
+					best.assign(response->begin() + 1, response->end());
+					bestGraph = graphIndex;
+				}
+			}
+			// Without any worker, the graphs would silently be replaced by qubit-wise collections
+			if (std::ranges::none_of(workers, &Worker::alive)) throw std::runtime_error("All worker processes stopped unexpectedly");
+
+			CollectionWithGraph collection{ {}, bestGraph ? graphs[*bestGraph] : Graph<>{ numQubits } };
+			for (auto index : best) collection.paulis.push_back(terms[index]);
+			if (collection.graph.edgeCount() == 0) collection.singleQubitLayer = computeQubitWiseLayer(collection.paulis, numQubits);
+			else computeSingleQubitLayer(collection, finder);
+
+			// Both lists are in ascending order
+			std::vector<uint64_t> left;
+			std::ranges::set_difference(remaining, best, std::back_inserter(left));
+			remaining = std::move(left);
+
+			if (options.graphsEvaluated) options.graphsEvaluated->push_back(numGraphsEvaluated);
+			collections.push_back(std::move(collection));
+			if (options.onCollection) options.onCollection(collections.back());
+			if (verbose) println("{} of {} remaining ({} group{}): {} -> {}\n",
+				remaining.size() + tail.size(), hamiltonian.operators.size(), collections.size(), collections.size() == 1 ? "" : "s",
+				collections.back().paulis, collections.back().graph.getEdges());
+		}
+
+		for (auto& worker : workers) {
+			if (!worker.alive) continue;
+			writeMessage(worker.requestFd, {});
+			stopWorker(worker, false);
+		}
+	}
+
+	if (!tail.empty()) {
+		const auto numCollections = collections.size();
+		const auto numInserted = insertTailPaulis(collections, tail, numQubits);
+		if (options.graphsEvaluated) options.graphsEvaluated->resize(collections.size());
+		if (verbose) println("Tail: {} Paulis with |coefficient| < {}, {} inserted into existing groups, {} grouped qubit-wise into {} new group{}",
+			tail.size(), options.tailThreshold, numInserted, tail.size() - numInserted, collections.size() - numCollections, collections.size() - numCollections == 1 ? "" : "s");
+	}
+	return collections;
+#endif
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "pauli_grouper.h"
+
+
+namespace Q {
+
+	/// @brief Group Paulis like applyPauliGrouper2Multithread2() with the greedy solver, but spread the graphs over
+	///        several local worker processes. Worker k owns the k-th of numProcesses contiguous ranges of graphs (a
+	///        segment of their Gray-code order) and keeps its own solver instances (options.numThreads each). In every
+	///        iteration, the coordinator sends the remaining Paulis to all workers over pipes, each worker answers with
+	///        its best collection for the main Pauli (see findBestCollection()) and the coordinator selects the largest
+	///        one, ties are broken in favour of the qubit-wise collection and then of the smaller graph index. The
+	///        result is therefore the same as with a single process and numMainPaulis = 1.
+	///
+	///        A worker that crashes (f.e. in the solver) is dropped and the run continues without its graphs. If all
+	///        workers are gone, std::runtime_error is thrown. Options other than numThreads, verbose,
+	///        incrementalConstraints, tailThreshold, graphsEvaluated and onCollection are ignored (readConfig() rejects
+	///        the others together with numProcesses > 1). Only available on POSIX systems.
+	///
+	/// @param hamiltonian   Hamiltonian specification
+	/// @param graphs        Allowed graphs
+	/// @param numProcesses  Number of worker processes
+	/// @param options       Options, see above
+	/// @return Sets of commuting operators
+	std::vector<CollectionWithGraph> applyPauliGrouperSharded(const Hamiltonian& hamiltonian, const std::vector<Graph<>>& graphs, int numProcesses, const GrouperOptions& options);
+
+}
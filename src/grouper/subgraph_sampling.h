@@ -0,0 +1,59 @@
+﻿#pragma once
+#include "graph.h"
+#include <bit>
+#include <stdexcept>
+
+namespace Q {
+
+
+	/// @brief Sample num random subgraphs of the graph with at most maxEdgeCount edges (all of them if there are at
+	///        most num subgraphs). 
+	template<class RNG>
+	auto getRandomSubgraphs(const Graph<>& graph, int64_t num, int maxEdgeCount, RNG&& rng) {
+		const auto edgeCount = graph.edgeCount();
+		if (edgeCount <= 63) {
+			// Check if num wanted graphs is greater or equal the total number of subgraphs
+			// then we just return all subgraphs 
+			const uint64_t totalNumSubgraphs = 1ULL << edgeCount;
+			if (num >= totalNumSubgraphs) {
+				return generateSubgraphs(graph, 0, maxEdgeCount);
+			}
+			else {
+				auto edges = graph.getEdges();
+				auto edgeMask = (1ULL << edgeCount) - 1;
+				std::vector<Graph<>> subgraphs;
+				while(subgraphs.size() < num) {
+					uint64_t randomInt = rng() & edgeMask;
+					if (const auto ec = std::popcount(randomInt); ec > maxEdgeCount) continue;
+
+					Graph<> subgraph(graph.graphSize);
+					for (size_t j = 0; j < edges.size(); ++j) {
+						if (randomInt & (1ULL << j)) {
+							subgraph.addEdge(edges[j].first, edges[j].second);
+						}
+					}
+					subgraphs.push_back(subgraph);
+				}
+				return subgraphs;
+			}
+		}
+		else {
+			throw std::runtime_error("More than 63 edges are currently not supported");
+		}
+	}
+
+
+	/// @brief Sample num subgraphs whose connected components have at most maxComponentSize vertices and the given
+	///        shape (all of them if there are at most num such subgraphs). 
+	template<class RNG>
+	auto getBoundedComponentSubgraphs(const Graph<>& graph, int64_t num, int maxEdgeCount, int maxComponentSize, ComponentShape shape, RNG&& rng) {
+		// Take the whole family if it has at most num members, otherwise sample from it. The family is only counted
+		// (up to num + 1) before it is decided, so large families are never stored. 
+		const auto limit = static_cast<size_t>(num) + 1;
+		if (countBoundedComponentSubgraphs(graph, maxComponentSize, maxEdgeCount, shape, limit) < limit) {
+			return generateBoundedComponentSubgraphs(graph, maxComponentSize, maxEdgeCount, shape);
+		}
+		return sampleBoundedComponentSubgraphs(graph, static_cast<size_t>(num), maxComponentSize, maxEdgeCount, shape, rng);
+	}
+
+}
@@ -0,0 +1,55 @@
+#include "catch2/catch_test_macros.hpp"
+
+#include "baseline_groupers.h"
+#include <algorithm>
+
+
+using namespace Q;
+
+
+namespace {
+	const Hamiltonian hamiltonian{ { 
+		{ Pauli{ "XX" }, 1. }, { Pauli{ "YY" }, -.9 }, { Pauli{ "ZZ" }, .8 }, { Pauli{ "XI" }, .5 }, 
+		{ Pauli{ "IX" }, -.4 }, { Pauli{ "ZI" }, .3 }, { Pauli{ "IY" }, .2 }, { Pauli{ "XY" }, .1 } }, 2 };
+
+	/// @brief Every term is grouped exactly once and the Paulis in each group commute pairwise
+	void requireValidGrouping(const std::vector<CollectionWithGraph>& grouping, Commutation commutation) {
+		for (const auto& [pauli, coefficient] : hamiltonian.operators) {
+			REQUIRE(std::ranges::count_if(grouping, [&](const auto& collection) { return std::ranges::count(collection.paulis, pauli) == 1; }) == 1);
+		}
+		size_t numPaulis{};
+		for (const auto& collection : grouping) {
+			numPaulis += collection.size();
+			REQUIRE(collection.graph.edgeCount() == 0);
+			REQUIRE(collection.singleQubitLayer.size() == (commutation == Commutation::QubitWise ? 2u : 0u));
+			for (const auto& p1 : collection.paulis) {
+				for (const auto& p2 : collection.paulis) {
+					REQUIRE((commutation == Commutation::QubitWise ? commutesQubitWise(p1, p2) : commutator(p1, p2) == 0));
+				}
+			}
+		}
+		REQUIRE(numPaulis == hamiltonian.operators.size());
+	}
+}
+
+
+TEST_CASE("applySortedInsertion") {
+	const auto general = applySortedInsertion(hamiltonian, Commutation::General);
+	requireValidGrouping(general, Commutation::General);
+	// The Paulis with the largest coefficients open the first group
+	REQUIRE(general[0].paulis == std::vector<Pauli>{ Pauli{ "XX" }, Pauli{ "YY" }, Pauli{ "ZZ" } });
+
+	const auto qubitWise = applySortedInsertion(hamiltonian, Commutation::QubitWise);
+	requireValidGrouping(qubitWise, Commutation::QubitWise);
+	REQUIRE(qubitWise[0].paulis == std::vector<Pauli>{ Pauli{ "XX" }, Pauli{ "XI" }, Pauli{ "IX" } });
+}
+
+TEST_CASE("applyGraphColoring") {
+	for (const auto commutation : { Commutation::General, Commutation::QubitWise }) {
+		for (const auto heuristic : { ColoringHeuristic::LargestFirst, ColoringHeuristic::DSatur }) {
+			requireValidGrouping(applyGraphColoring(hamiltonian, commutation, heuristic), commutation);
+			requireValidGrouping(applyGraphColoring(hamiltonian, commutation, heuristic, 3), commutation);
+		}
+	}
+	REQUIRE(applyGraphColoring(Hamiltonian{ {}, 2 }, Commutation::General, ColoringHeuristic::DSatur).empty());
+}
@@ -0,0 +1,86 @@
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/catch_approx.hpp"
+
+#include "checkpoint.h"
+#include "temporary_files.h"
+
+
+using namespace Q;
+
+
+TEST_CASE("Checkpoint round trip") {
+	const Hamiltonian hamiltonian{ { { Pauli{ "XX" }, 1. }, { Pauli{ "ZZ" }, -.5 }, { Pauli{ "XI" }, .25 } }, 2 };
+	Graph<> graph{ 2 };
+	graph.addEdge(0, 1);
+	const std::vector<BinaryCliffordGate> layer{
+		BinaryCliffordGate{ Binary(1), Binary(0), Binary(0), Binary(1) },
+		BinaryCliffordGate{ Binary(0), Binary(1), Binary(1), Binary(1) }
+	};
+
+	GrouperCheckpoint checkpoint{
+		.seed = 1234,
+		.numQubits = 2,
+		.numTerms = 3,
+		.numGraphs = 1,
+		.setupHash = checkpointSetupHash(hamiltonian, { graph }, GrouperOptions{}),
+		.collections = { { { Pauli{ "XX" }, Pauli{ "ZZ" } }, graph, layer } },
+		.remaining = { 2 },
+		.randomGeneratorState = "1 2 3",
+		.graphStatistics = { { 4, 3, 2, 1.5, 6., .25 } },
+		.numGraphEvaluations = 4,
+		.numExhaustiveGraphEvaluations = 5,
+		.numPrunedUnits = 1,
+		.graphsEvaluated = { 1 },
+		.elapsedSeconds = 12.5,
+		.secondsPerUnit = .125,
+		.lastCollectionSize = 2
+	};
+	const auto filename = temporaryFilename("checkpoint_tests.checkpoint");
+	writeCheckpoint(filename, checkpoint, hamiltonian);
+	const auto read = readCheckpoint(filename, hamiltonian);
+
+	REQUIRE(read.seed == checkpoint.seed);
+	REQUIRE(read.numQubits == checkpoint.numQubits);
+	REQUIRE(read.numTerms == checkpoint.numTerms);
+	REQUIRE(read.numGraphs == checkpoint.numGraphs);
+	REQUIRE(read.setupHash == checkpoint.setupHash);
+	REQUIRE(read.collections.size() == 1);
+	REQUIRE(read.collections[0].paulis == checkpoint.collections[0].paulis);
+	REQUIRE(read.collections[0].graph == graph);
+	REQUIRE(read.collections[0].singleQubitLayer == layer);
+	REQUIRE(read.remaining == checkpoint.remaining);
+	REQUIRE(read.randomGeneratorState == checkpoint.randomGeneratorState);
+	REQUIRE(read.graphStatistics.size() == 1);
+	REQUIRE(read.graphStatistics[0].evaluations == 4);
+	REQUIRE(read.graphStatistics[0].feasible == 3);
+	REQUIRE(read.graphStatistics[0].wins == 2);
+	REQUIRE(read.graphStatistics[0].totalReward == 1.5);
+	REQUIRE(read.graphStatistics[0].totalSize == 6.);
+	REQUIRE(read.graphStatistics[0].totalSeconds == .25);
+	REQUIRE(read.numGraphEvaluations == 4);
+	REQUIRE(read.numExhaustiveGraphEvaluations == 5);
+	REQUIRE(read.numPrunedUnits == 1);
+	REQUIRE(read.graphsEvaluated == checkpoint.graphsEvaluated);
+	REQUIRE(read.elapsedSeconds == 12.5);
+	REQUIRE(read.secondsPerUnit == .125);
+	REQUIRE(read.lastCollectionSize == 2);
+	// The temporary file was renamed
+	REQUIRE(!std::filesystem::exists(filename + ".tmp"));
+
+	const Hamiltonian otherHamiltonian{ { { Pauli{ "XX" }, 1. } }, 2 };
+	REQUIRE_THROWS_AS(readCheckpoint(filename, otherHamiltonian), CheckpointError);
+	std::filesystem::remove(filename);
+}
+
+TEST_CASE("Checkpoint setup hash") {
+	const Hamiltonian hamiltonian{ { { Pauli{ "XX" }, 1. }, { Pauli{ "ZZ" }, -.5 } }, 2 };
+	const std::vector<Graph<>> graphs{ Graph<>::linear(2), Graph<>{ 2 } };
+	const auto hash = checkpointSetupHash(hamiltonian, graphs, GrouperOptions{});
+
+	REQUIRE(checkpointSetupHash(hamiltonian, graphs, GrouperOptions{ .numThreads = 4 }) == hash);
+	REQUIRE(checkpointSetupHash(hamiltonian, { graphs[1], graphs[0] }, GrouperOptions{}) != hash);
+	REQUIRE(checkpointSetupHash(hamiltonian, graphs, GrouperOptions{ .numMainPaulis = 2 }) != hash);
+	REQUIRE(checkpointSetupHash(hamiltonian, graphs, GrouperOptions{ .tailThreshold = .6 }) != hash);
+	const Hamiltonian otherCoefficients{ { { Pauli{ "XX" }, 1. }, { Pauli{ "ZZ" }, .5 } }, 2 };
+	REQUIRE(checkpointSetupHash(otherCoefficients, graphs, GrouperOptions{}) != hash);
+}
@@ -0,0 +1,60 @@
+#include "catch2/catch_test_macros.hpp"
+
+#include "graph_prior.h"
+#include "temporary_files.h"
+
+
+using namespace Q;
+
+
+TEST_CASE("GraphPrior round trip") {
+	Graph<> first{ 3 };
+	first.addEdge(0, 1);
+	Graph<> second{ 3 };
+	second.addEdge(1, 2);
+	second.addEdge(0, 1);
+
+	GraphPrior prior{ 3 };
+	prior.addWins({ { {}, first }, { {}, second }, { {}, first }, { {}, Graph<>{ 3 } } });
+	// Edges are only added once a graph with them wins
+	REQUIRE(prior.edges.size() == 2);
+
+	const auto filename = temporaryFilename("graph_prior_tests.txt");
+	writeGraphPrior(filename, prior);
+	const auto read = readGraphPrior(filename);
+	REQUIRE(read.numQubits == 3);
+	REQUIRE(read.edges == prior.edges);
+	REQUIRE(read.wins == prior.wins);
+	REQUIRE(read.getGraphs(Graph<>::linear(3), 10) == std::vector{ first, second });
+	REQUIRE(read.getGraphs(Graph<>::linear(3), 1) == std::vector{ first });
+}
+
+TEST_CASE("GraphPrior with more than 64 edges") {
+	GraphPrior prior{ 64 };
+	for (int i = 0; i < 63; ++i) {
+		Graph<> graph{ 64 };
+		graph.addEdge(i, i + 1);
+		prior.addWins({ { {}, graph } });
+	}
+	Graph<> graph{ 64 };
+	graph.addEdge(0, 2);
+	prior.addWins({ { {}, graph } });
+	REQUIRE(prior.edges.size() == 64);
+	graph.addEdge(0, 3);
+	REQUIRE_THROWS_AS(prior.addWins({ { {}, graph } }), GraphPriorError);
+
+	std::string edges = "qubits 64\nedges";
+	for (int i = 0; i < 63; ++i) edges += std::format(" {}-{}", i, i + 1);
+	REQUIRE(readGraphPrior(writeTemporaryFile("graph_prior_tests.txt", edges + " 0-2\n")).edges.size() == 64);
+	REQUIRE_THROWS_AS(readGraphPrior(writeTemporaryFile("graph_prior_tests.txt", edges + " 0-2 0-3\n")), GraphPriorError);
+}
+
+TEST_CASE("Invalid graph priors") {
+	REQUIRE_THROWS_AS(readGraphPrior(writeTemporaryFile("graph_prior_tests.txt", "qubits 3\nedges 0-3\n")), GraphPriorError);
+	REQUIRE_THROWS_AS(readGraphPrior(writeTemporaryFile("graph_prior_tests.txt", "qubits 3\nedges 1-1\n")), GraphPriorError);
+	REQUIRE_THROWS_AS(readGraphPrior(writeTemporaryFile("graph_prior_tests.txt", "qubits 3\nedges 0-x\n")), GraphPriorError);
+	REQUIRE_THROWS_AS(readGraphPrior(writeTemporaryFile("graph_prior_tests.txt", "qubits 3\nedges 0-99999999999\n")), GraphPriorError);
+	REQUIRE_THROWS_AS(readGraphPrior(writeTemporaryFile("graph_prior_tests.txt", "qubits three\n")), GraphPriorError);
+	REQUIRE_THROWS_AS(readGraphPrior(writeTemporaryFile("graph_prior_tests.txt", "qubits 3\nedges 0-1\n2 1\n")), GraphPriorError);
+	REQUIRE_THROWS_AS(readGraphPrior(writeTemporaryFile("graph_prior_tests.txt", "edges 0-1\n1 1\n")), GraphPriorError);
+}
@@ -0,0 +1,97 @@
+#include "catch2/catch_test_macros.hpp"
+
+#include "pauli_grouper.h"
+#include "formatting.h"
+#include "json_formatting.h"
+#include "json_parser.h"
+#include "temporary_files.h"
+#include <limits>
+#include <map>
+#include <ranges>
+
+
+using namespace Q;
+
+
+namespace {
+	std::vector<JsonValue> readJsonLines(const std::string& filename) {
+		std::ifstream file{ filename };
+		std::vector<JsonValue> lines;
+		for (std::string line; std::getline(file, line);) lines.push_back(JsonParser{ line }.parseDocument());
+		return lines;
+	}
+
+	std::vector<std::string> operatorsOf(const JsonValue& group) {
+		std::vector<std::string> operators;
+		for (const auto& pauli : std::get<JsonValue::Array>(group.find("operators")->value)) operators.push_back(std::get<std::string>(pauli.value));
+		return operators;
+	}
+}
+
+
+TEST_CASE("JsonLinesWriter round trip") {
+	auto qubitWise = [](std::vector<Pauli> paulis) { 
+		CollectionWithGraph collection{ paulis, Graph<>{ 2 } };
+		collection.singleQubitLayer = computeQubitWiseLayer(collection.paulis, 2);
+		return collection;
+	};
+	std::vector<CollectionWithGraph> collections{ qubitWise({ Pauli{ "XX" } }), qubitWise({ Pauli{ "ZZ" } }), qubitWise({ Pauli{ "YY" } }) };
+
+	const auto filename = temporaryFilename("json_formatting_tests.jsonl");
+	{
+		JsonFormatting::JsonLinesWriter writer{ filename };
+		for (const auto& collection : collections) writer.write(collection);
+		// The first group grows (f.e. through tail insertion) and the last one disappears (f.e. through refinement)
+		collections[0] = qubitWise({ Pauli{ "XX" }, Pauli{ "XI" } });
+		collections.pop_back();
+		const JsonFormatting::MetaInfo metaInfo{ .timeInSeconds = 3, .numGraphs = 4, .randomSeed = 5, .tailThreshold = .1,
+			.rHatLossBound = std::numeric_limits<double>::infinity() };
+		writer.finish(collections, metaInfo, 1.5);
+	}
+
+	const auto lines = readJsonLines(filename);
+	// Three groups, the changed first group and the summary, the unchanged second group is not written again
+	REQUIRE(lines.size() == 5);
+	REQUIRE(std::get<double>(lines[3].find("index")->value) == 0);
+	const auto& summary = *lines.back().find("summary");
+	REQUIRE(std::get<double>(summary.find("num groups")->value) == 2);
+	REQUIRE(std::get<double>(summary.find("runtime [seconds]")->value) == 3);
+	REQUIRE(std::get<double>(summary.find("num graphs")->value) == 4);
+	REQUIRE(std::get<double>(summary.find("random seed")->value) == 5);
+	REQUIRE(std::get<double>(summary.find("R_hat")->value) == 1.5);
+	REQUIRE(std::get<double>(summary.find("tail threshold")->value) == .1);
+	// Not finite, JSON has no inf
+	REQUIRE(std::holds_alternative<std::nullptr_t>(summary.find("R_hat loss bound")->value));
+
+	// Read like read_grouping_from_json_lines(): the last line of each index counts, indices from "num groups" on are dropped
+	std::map<size_t, const JsonValue*> groups;
+	for (const auto& line : lines | std::views::take(lines.size() - 1)) groups[static_cast<size_t>(std::get<double>(line.find("index")->value))] = &line;
+	REQUIRE(operatorsOf(*groups.at(0)) == std::vector<std::string>{ "XX", "XI" });
+	REQUIRE(operatorsOf(*groups.at(1)) == std::vector<std::string>{ "ZZ" });
+	// Group 2 was written while running but is not part of the final grouping
+	REQUIRE(groups.size() == 3);
+	for (const auto& [index, group] : groups) {
+		REQUIRE(std::get<JsonValue::Array>(group->find("edges")->value).empty());
+		REQUIRE(std::get<JsonValue::Array>(group->find("cliffords")->value).size() == 2);
+	}
+}
+
+TEST_CASE("printPauliCollections") {
+	Graph<> graph{ 2 };
+	graph.addEdge(0, 1);
+	const std::vector<CollectionWithGraph> grouping{ { { Pauli{ "XZ" }, Pauli{ "ZX" } }, graph, std::vector<BinaryCliffordGate>(2, BinaryCliffordGates::I) } };
+
+	std::string measurable;
+	JsonFormatting::printPauliCollections(std::back_inserter(measurable), grouping, JsonFormatting::MetaInfo{ .connectivity = graph });
+	const auto document = JsonParser{ measurable }.parseDocument();
+	const auto& group = std::get<JsonValue::Array>(document.find("grouping")->value).front();
+	REQUIRE(operatorsOf(group) == std::vector<std::string>{ "XZ", "ZX" });
+	REQUIRE(std::get<JsonValue::Array>(group.find("edges")->value).size() == 1);
+	REQUIRE(std::get<JsonValue::Array>(group.find("cliffords")->value).size() == 2);
+
+	// Groups of general-commutation baselines have no readout circuit
+	std::string baseline;
+	JsonFormatting::printPauliCollections(std::back_inserter(baseline), grouping, JsonFormatting::MetaInfo{ .measurable = false });
+	const auto baselineGroup = std::get<JsonValue::Array>(JsonParser{ baseline }.parseDocument().find("grouping")->value).front();
+	REQUIRE(std::holds_alternative<std::nullptr_t>(baselineGroup.find("cliffords")->value));
+}
@@ -0,0 +1,74 @@
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/catch_approx.hpp"
+
+#include "json_parser.h"
+
+
+using namespace Q;
+
+
+namespace {
+
+	// Message of the JsonParseError thrown for the given text (empty if none is thrown)
+	std::string parseErrorFor(std::string_view text) {
+		try {
+			JsonParser{ text }.parseDocument();
+		}
+		catch (const JsonParseError& e) {
+			return e.what();
+		}
+		return "";
+	}
+}
+
+
+TEST_CASE("JsonParser values") {
+	REQUIRE(std::get<double>(JsonParser{ " -1.5e2 " }.parseDocument().value) == -150.);
+	REQUIRE(std::get<bool>(JsonParser{ "true" }.parseDocument().value));
+	REQUIRE(!std::get<bool>(JsonParser{ "false" }.parseDocument().value));
+	REQUIRE(std::holds_alternative<std::nullptr_t>(JsonParser{ "null" }.parseDocument().value));
+	REQUIRE(std::get<std::string>(JsonParser{ "\"\"" }.parseDocument().value).empty());
+	REQUIRE(std::get<JsonValue::Array>(JsonParser{ "[ ]" }.parseDocument().value).empty());
+	REQUIRE(std::get<JsonValue::Object>(JsonParser{ "{ }" }.parseDocument().value).empty());
+}
+
+TEST_CASE("JsonParser escapes") {
+	const auto value = JsonParser{ R"("a\"b\\c\/d\ne\tf\rg\bh\fi")" }.parseDocument();
+	REQUIRE(std::get<std::string>(value.value) == "a\"b\\c/d\ne\tf\rg\bh\fi");
+	REQUIRE(parseErrorFor(R"("\A")") == "Unsupported escape sequence at column 4");
+	REQUIRE(parseErrorFor(R"("abc\)") == "Unterminated string at column 6");
+}
+
+TEST_CASE("JsonParser nesting") {
+	const auto request = JsonParser{ R"({"id": 1, "params": {"connectivity": [[0, 1], [1, 2]], "hamiltonian": {"XX": 0.5}}})" }.parseDocument();
+	REQUIRE(std::get<double>(request.find("id")->value) == 1.);
+	REQUIRE(request.find("method") == nullptr);
+	const auto params = request.find("params");
+	REQUIRE(params != nullptr);
+	const auto& edges = std::get<JsonValue::Array>(params->find("connectivity")->value);
+	REQUIRE(edges.size() == 2);
+	REQUIRE(std::get<double>(std::get<JsonValue::Array>(edges[1].value)[0].value) == 1.);
+	REQUIRE(std::get<double>(params->find("hamiltonian")->find("XX")->value) == .5);
+	// find() on something other than an object
+	REQUIRE(edges[0].find("XX") == nullptr);
+
+	const auto deep = std::string(JsonParser::maxDepth, '[') + std::string(JsonParser::maxDepth, ']');
+	REQUIRE(std::holds_alternative<JsonValue::Array>(JsonParser{ deep }.parseDocument().value));
+	const auto tooDeep = std::string(JsonParser::maxDepth + 1, '[') + std::string(JsonParser::maxDepth + 1, ']');
+	REQUIRE(parseErrorFor(tooDeep).starts_with("Nesting too deep"));
+}
+
+TEST_CASE("JsonParser malformed input") {
+	REQUIRE(parseErrorFor("") == "Unexpected end of document at column 1");
+	REQUIRE(parseErrorFor("{\"a\": 1,}") == "Expected a key in double quotes at column 9");
+	REQUIRE(parseErrorFor("{\"a\" 1}") == "Expected ':' at column 6");
+	REQUIRE(parseErrorFor("{\"a\": 1") == "Expected ',' or '}' at column 8");
+	REQUIRE(parseErrorFor("{\"a\": 1]") == "Expected ',' or '}' at column 9");
+	REQUIRE(parseErrorFor("[1, 2") == "Expected ',' or ']' at column 6");
+	REQUIRE(parseErrorFor("[1 2]") == "Expected ',' or ']' at column 5");
+	REQUIRE(parseErrorFor("[1,]") == "Invalid value at column 4");
+	REQUIRE(parseErrorFor("tru") == "Invalid value at column 1");
+	REQUIRE(parseErrorFor("nan") == "Invalid value at column 1");
+	REQUIRE(parseErrorFor("inf") == "Invalid value at column 1");
+	REQUIRE(parseErrorFor("{} {}") == "Unexpected characters after the document at column 4");
+}
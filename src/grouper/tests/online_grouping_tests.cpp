@@ -0,0 +1,88 @@
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/catch_approx.hpp"
+
+#include "online_grouping.h"
+#include "estimated_shot_reduction.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+using namespace Q;
+
+
+namespace {
+	template<class Range, class Value>
+	bool contains(const Range& range, const Value& value) { return std::ranges::find(range, value) != std::ranges::end(range); }
+
+	/// @brief Each term is in exactly one collection and R_hat matches a full evaluation
+	void requireConsistent(const OnlineGrouping& online) {
+		const auto hamiltonian = online.getHamiltonian();
+		size_t numPaulis{};
+		for (const auto& collection : online.getGrouping()) numPaulis += collection.size();
+		REQUIRE(numPaulis == online.numTerms());
+		for (const auto& [pauli, coefficient] : hamiltonian.operators) {
+			REQUIRE(std::ranges::count_if(online.getGrouping(), [&](const auto& collection) { return contains(collection.paulis, pauli); }) == 1);
+		}
+		REQUIRE(online.getRHat() == Catch::Approx(estimated_shot_reduction(hamiltonian, online.getGrouping())));
+	}
+}
+
+
+TEST_CASE("OnlineGrouping insert and remove") {
+	const Hamiltonian hamiltonian{ { { Pauli{ "XX" }, 1. }, { Pauli{ "ZZ" }, .5 }, { Pauli{ "XI" }, .25 } }, 2 };
+	// A threshold of 1 never triggers a full grouping
+	OnlineGrouping online{ hamiltonian, { Graph<>::linear(2), Graph<>{ 2 } }, GrouperOptions{ .verbose = false }, 1. };
+	REQUIRE(online.numTerms() == 3);
+	REQUIRE(online.numRegroups() == 1);
+	requireConsistent(online);
+
+	// The phase is folded into the coefficient
+	REQUIRE(!online.insert(Pauli{ "-YY" }, .5));
+	REQUIRE(online.numTerms() == 4);
+	REQUIRE(contains(online.getHamiltonian().operators, std::pair{ Pauli{ "YY" }, -.5 }));
+	requireConsistent(online);
+
+	// Paulis that only differ in their phase are the same term
+	REQUIRE(!online.insert(Pauli{ "YY" }, 2.));
+	REQUIRE(online.numTerms() == 4);
+	REQUIRE(contains(online.getHamiltonian().operators, std::pair{ Pauli{ "YY" }, 2. }));
+	requireConsistent(online);
+
+	REQUIRE(!online.remove(Pauli{ "-YY" }));
+	REQUIRE(online.numTerms() == 3);
+	for (const auto& collection : online.getGrouping()) REQUIRE(!contains(collection.paulis, Pauli{ "YY" }));
+	requireConsistent(online);
+
+	REQUIRE_THROWS_AS(online.remove(Pauli{ "YY" }), std::invalid_argument);
+	REQUIRE_THROWS_AS(online.insert(Pauli{ "iXZ" }, 1.), std::invalid_argument);
+	REQUIRE(online.numRegroups() == 1);
+}
+
+TEST_CASE("OnlineGrouping dissolves collections") {
+	const Hamiltonian hamiltonian{ { { Pauli{ "XI" }, 1. }, { Pauli{ "IZ" }, 1. } }, 2 };
+	OnlineGrouping online{ hamiltonian, { Graph<>{ 2 } }, GrouperOptions{ .verbose = false }, 1. };
+	REQUIRE(online.getGrouping().size() == 1);
+
+	// ZI is not qubit-wise compatible with XI and opens a new collection
+	REQUIRE(!online.insert(Pauli{ "ZI" }, .5));
+	REQUIRE(online.getGrouping().size() == 2);
+	requireConsistent(online);
+
+	// Without XI, the remaining IZ fits into the collection of ZI
+	REQUIRE(!online.remove(Pauli{ "XI" }));
+	REQUIRE(online.getGrouping().size() == 1);
+	REQUIRE(online.getGrouping()[0].size() == 2);
+	requireConsistent(online);
+}
+
+TEST_CASE("OnlineGrouping regroups below the threshold") {
+	const Hamiltonian hamiltonian{ { { Pauli{ "XI" }, 1. }, { Pauli{ "IZ" }, 1. } }, 2 };
+	OnlineGrouping online{ hamiltonian, { Graph<>{ 2 } }, GrouperOptions{ .verbose = false }, .05 };
+	REQUIRE(online.getReferenceRHat() == Catch::Approx(2.));
+
+	// A new collection with ZI drops R_hat from 2 to 9 / (√2 + 1)² ≈ 1.54
+	REQUIRE(online.insert(Pauli{ "ZI" }, 1.));
+	REQUIRE(online.numRegroups() == 2);
+	REQUIRE(online.getRHat() == Catch::Approx(online.getReferenceRHat()));
+	requireConsistent(online);
+}
@@ -0,0 +1,114 @@
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/catch_approx.hpp"
+
+#include "pauli_grouper.h"
+#include "estimated_shot_reduction.h"
+#include <limits>
+
+
+using namespace Q;
+
+
+TEST_CASE("tailThresholdForWeightFraction") {
+	const Hamiltonian hamiltonian{ { { Pauli{ "XX" }, 4. }, { Pauli{ "ZZ" }, -2. }, { Pauli{ "XI" }, 1. }, { Pauli{ "IZ" }, -1. } }, 2 };
+	// The two terms with |coefficient| 1 make up a quarter of the summed absolute coefficients
+	REQUIRE(tailThresholdForWeightFraction(hamiltonian, .25) == 2.);
+	REQUIRE(tailThresholdForWeightFraction(hamiltonian, .2) == 1.);
+	REQUIRE(tailThresholdForWeightFraction(hamiltonian, 0.) == 1.);
+	// All but the largest term
+	REQUIRE(tailThresholdForWeightFraction(hamiltonian, .5) == 4.);
+	REQUIRE(tailThresholdForWeightFraction(hamiltonian, 1.) == std::numeric_limits<double>::infinity());
+}
+
+TEST_CASE("insertTailPaulis") {
+	const std::vector<Pauli> paulis{ Pauli{ "XIX" }, Pauli{ "XXI" } };
+	std::vector<CollectionWithGraph> grouping{ { paulis, Graph<>{ 3 }, computeQubitWiseLayer(paulis, 3) } };
+
+	// IXX fits the X basis on all qubits, IZI needs Z on qubit 1 which IXX has just claimed
+	const std::vector<std::pair<Pauli, double>> tail{ { Pauli{ "IXX" }, .1 }, { Pauli{ "IZI" }, .1 }, { Pauli{ "ZIZ" }, .1 } };
+	REQUIRE(insertTailPaulis(grouping, tail, 3) == 1);
+	REQUIRE(grouping.size() == 2);
+	REQUIRE(grouping[0].paulis == std::vector<Pauli>{ Pauli{ "XIX" }, Pauli{ "XXI" }, Pauli{ "IXX" } });
+	REQUIRE(grouping[0].singleQubitLayer == computeQubitWiseLayer(grouping[0].paulis, 3));
+	// The leftovers commute qubit-wise and share a new collection
+	REQUIRE(grouping[1].paulis.size() == 2);
+	REQUIRE(grouping[1].graph.edgeCount() == 0);
+
+	for (const auto& collection : grouping) {
+		const DiagonalizationCheck check{ collection, 3 };
+		for (const auto& pauli : collection.paulis) REQUIRE(check.diagonalizes(pauli));
+	}
+}
+
+TEST_CASE("insertTailPaulis with a graph") {
+	// With the identity layer, the circuit of the edge 0-1 measures the stabilizers XZ and ZX of the graph state
+	std::vector<CollectionWithGraph> grouping{ { { Pauli{ "XZ" } }, Graph<>::linear(2), std::vector<BinaryCliffordGate>(2, BinaryCliffordGates::I) } };
+
+	const std::vector<std::pair<Pauli, double>> tail{ { Pauli{ "ZX" }, .1 }, { Pauli{ "ZZ" }, .1 }, { Pauli{ "YY" }, .1 } };
+	REQUIRE(insertTailPaulis(grouping, tail, 2) == 2);
+	REQUIRE(grouping.size() == 2);
+	REQUIRE(grouping[0].paulis == std::vector<Pauli>{ Pauli{ "XZ" }, Pauli{ "ZX" }, Pauli{ "YY" } });
+	REQUIRE(grouping[0].graph == Graph<>::linear(2));
+	REQUIRE(grouping[0].singleQubitLayer == std::vector<BinaryCliffordGate>(2, BinaryCliffordGates::I));
+	REQUIRE(grouping[1].paulis == std::vector<Pauli>{ Pauli{ "ZZ" } });
+
+	for (const auto& collection : grouping) {
+		const DiagonalizationCheck check{ collection, 2 };
+		for (const auto& pauli : collection.paulis) REQUIRE(check.diagonalizes(pauli));
+	}
+	REQUIRE(!DiagonalizationCheck{ grouping[0], 2 }.diagonalizes(Pauli{ "XX" }));
+}
+
+TEST_CASE("estimated_shot_reduction_bound") {
+	const Hamiltonian hamiltonian{ { { Pauli{ "XX" }, 1. }, { Pauli{ "ZZ" }, .5 }, { Pauli{ "II" }, 2. } }, 2 };
+	const std::vector<CollectionWithGraph> grouping{ { { Pauli{ "XX" }, Pauli{ "II" } }, Graph<>{ 2 } }, { { Pauli{ "ZZ" } }, Graph<>{ 2 } } };
+	REQUIRE(estimated_shot_reduction(hamiltonian, grouping) == Catch::Approx(1.));
+	REQUIRE(estimated_shot_reduction_bound(hamiltonian, grouping, 0.) == Catch::Approx(1.));
+	// ZZ is a tail term and is left out of the denominator
+	REQUIRE(estimated_shot_reduction_bound(hamiltonian, grouping, .6) == Catch::Approx(2.25));
+	// All measured terms are tail terms
+	REQUIRE(estimated_shot_reduction_bound(hamiltonian, grouping, 1.5) == std::numeric_limits<double>::infinity());
+}
+
+TEST_CASE("CollectionCache") {
+	const std::vector<std::pair<Pauli, double>> terms{ { Pauli{ "XX" }, 1. }, { Pauli{ "ZZ" }, .5 } };
+	const std::vector<std::pair<Pauli, double>> swapped{ terms[1], terms[0] };
+	const auto fingerprint = CollectionCache::fingerprint(terms);
+	// Term lists are ordered (the main Pauli comes first), sets of Paulis are not
+	REQUIRE(fingerprint != CollectionCache::fingerprint(swapped));
+	const std::vector<Pauli> paulis{ Pauli{ "XX" }, Pauli{ "ZZ" } };
+	const std::vector<Pauli> swappedPaulis{ Pauli{ "ZZ" }, Pauli{ "XX" } };
+	REQUIRE(CollectionCache::setFingerprint(paulis) == CollectionCache::setFingerprint(swappedPaulis));
+	REQUIRE(CollectionCache::setFingerprint(paulis) != CollectionCache::setFingerprint(std::vector{ paulis[0] }));
+
+	const auto graph = Graph<>::linear(2);
+	CollectionCache cache{ 2 };
+	REQUIRE(!cache.find(graph, fingerprint));
+	cache.insert(graph, fingerprint, paulis);
+	cache.insert(Graph<>{ 2 }, fingerprint, std::nullopt);
+	const auto found = cache.find(graph, fingerprint);
+	REQUIRE((found && *found == paulis));
+	// The main Pauli was not measurable with the edgeless graph
+	const auto notMeasurable = cache.find(Graph<>{ 2 }, fingerprint);
+	REQUIRE((notMeasurable && !*notMeasurable));
+	REQUIRE(!cache.find(graph, CollectionCache::fingerprint(swapped)));
+	REQUIRE(cache.numLookups() == 4);
+	REQUIRE(cache.numHits() == 2);
+
+	// The oldest entry is evicted beyond two entries
+	cache.insert(graph, CollectionCache::fingerprint(swapped), swappedPaulis);
+	REQUIRE(cache.size() == 2);
+	REQUIRE(!cache.find(graph, fingerprint));
+	REQUIRE(cache.find(Graph<>{ 2 }, fingerprint));
+
+	cache.insertFeasibility(graph, CollectionCache::setFingerprint(paulis), true);
+	REQUIRE(cache.findFeasibility(graph, CollectionCache::setFingerprint(swappedPaulis)) == true);
+	REQUIRE(!cache.findFeasibility(Graph<>{ 2 }, CollectionCache::setFingerprint(paulis)));
+	REQUIRE(cache.numFeasibilityHits() == 1);
+
+	// Read-only caches keep answering but store nothing
+	cache.setReadOnly(true);
+	cache.insertFeasibility(Graph<>{ 2 }, CollectionCache::setFingerprint(paulis), false);
+	REQUIRE(!cache.findFeasibility(Graph<>{ 2 }, CollectionCache::setFingerprint(paulis)));
+	REQUIRE(cache.findFeasibility(graph, CollectionCache::setFingerprint(paulis)) == true);
+}
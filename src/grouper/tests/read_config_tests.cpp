@@ -0,0 +1,63 @@
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/catch_approx.hpp"
+
+#include "read_config.h"
+#include "temporary_files.h"
+
+
+using namespace Q;
+
+
+TEST_CASE("readBatch") {
+	Configuration config;
+	config.numGraphs = 100;
+
+	const auto filename = writeTemporaryFile("read_config_tests.batch", 
+		"# filename connectivity numGraphs seed outfilename\n"
+		"h2.json linear4.txt default 0 h2_out.json\n"
+		"\n"
+		"  lih.json grid.txt 20 7 lih_out.json  # comment\n");
+	const auto jobs = readBatch(filename, config);
+	REQUIRE(jobs.size() == 2);
+	REQUIRE(jobs[0].filename == "h2.json");
+	REQUIRE(jobs[0].connectivity == "linear4.txt");
+	REQUIRE(jobs[0].numGraphs == 100);
+	REQUIRE(jobs[0].seed == 0);
+	REQUIRE(jobs[0].outfilename == "h2_out.json");
+	REQUIRE(jobs[1].numGraphs == 20);
+	REQUIRE(jobs[1].seed == 7);
+
+	// Malformed numbers are reported as configuration errors
+	REQUIRE_THROWS_AS(readBatch(writeTemporaryFile("read_config_tests.batch", "a.json b.txt 10 abc out.json\n"), config), ConfigReadError);
+	REQUIRE_THROWS_AS(readBatch(writeTemporaryFile("read_config_tests.batch", "a.json b.txt many 1 out.json\n"), config), ConfigReadError);
+	REQUIRE_THROWS_AS(readBatch(writeTemporaryFile("read_config_tests.batch", "a.json b.txt 10 -1 out.json\n"), config), ConfigReadError);
+	REQUIRE_THROWS_AS(readBatch(writeTemporaryFile("read_config_tests.batch", "a.json b.txt 10 99999999999999999999 out.json\n"), config), ConfigReadError);
+	REQUIRE_THROWS_AS(readBatch(writeTemporaryFile("read_config_tests.batch", "a.json b.txt 10 out.json\n"), config), ConfigReadError);
+	REQUIRE_THROWS_AS(readBatch(writeTemporaryFile("read_config_tests.batch", "# only a comment\n"), config), ConfigReadError);
+}
+
+TEST_CASE("readScan") {
+	const auto points = readScan(writeTemporaryFile("read_config_tests.scan",
+		"# label coefficients\n"
+		"0.7 1.5 -0.25\n"
+		"\n"
+		"0.8 1e-3 2 # comment\n"), 2);
+	REQUIRE(points.size() == 2);
+	REQUIRE(points[0].label == "0.7");
+	REQUIRE(points[0].coefficients == std::vector{ 1.5, -0.25 });
+	REQUIRE(points[1].label == "0.8");
+	REQUIRE(points[1].coefficients == std::vector{ 1e-3, 2. });
+
+	REQUIRE_THROWS_AS(readScan(writeTemporaryFile("read_config_tests.scan", "a 1 2 3\n"), 2), ConfigReadError);
+	REQUIRE_THROWS_AS(readScan(writeTemporaryFile("read_config_tests.scan", "a 1 x\n"), 2), ConfigReadError);
+	REQUIRE_THROWS_AS(readScan(writeTemporaryFile("read_config_tests.scan", "a 1 2\na 3 4\n"), 2), ConfigReadError);
+	REQUIRE_THROWS_AS(readScan(writeTemporaryFile("read_config_tests.scan", "../a 1 2\n"), 2), ConfigReadError);
+	REQUIRE_THROWS_AS(readScan(writeTemporaryFile("read_config_tests.scan", "sub/a 1 2\n"), 2), ConfigReadError);
+	REQUIRE_THROWS_AS(readScan(writeTemporaryFile("read_config_tests.scan", "sub\\a 1 2\n"), 2), ConfigReadError);
+	REQUIRE_THROWS_AS(readScan(writeTemporaryFile("read_config_tests.scan", "# only a comment\n"), 2), ConfigReadError);
+}
+
+TEST_CASE("readConfig rejects duplicate attributes") {
+	REQUIRE_THROWS_AS(readConfig(writeTemporaryFile("read_config_tests.txt", "resume = false\nresume = true\n")), ConfigReadError);
+	REQUIRE_THROWS_AS(readConfig(writeTemporaryFile("read_config_tests.txt", "numThreads = 2\nnumThreads = 2\n")), ConfigReadError);
+}
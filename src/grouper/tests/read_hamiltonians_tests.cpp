@@ -0,0 +1,144 @@
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/catch_approx.hpp"
+
+#include "binary_hamiltonian.h"
+#include "temporary_files.h"
+
+
+using namespace Q;
+
+
+namespace {
+
+	// Message of the ReadHamiltonianError thrown for the given file content (empty if none is thrown)
+	std::string jsonErrorFor(const std::string& content) {
+		const auto filename = writeTemporaryFile("read_hamiltonians_tests.json", content);
+		try {
+			readHamiltonianFromJson(filename);
+		}
+		catch (const ReadHamiltonianError& e) {
+			return e.what();
+		}
+		return "";
+	}
+}
+
+
+TEST_CASE("readHamiltonianFromJson single line") {
+	const auto filename = writeTemporaryFile("read_hamiltonians_tests.json", R"({"XXI": 0.5, "IZZ":-1.25,"YIY" :2e-3})");
+	const auto hamiltonian = readHamiltonianFromJson(filename);
+	REQUIRE(hamiltonian.numQubits == 3);
+	REQUIRE(hamiltonian.operators.size() == 3);
+	REQUIRE(hamiltonian.operators[0] == std::pair{ Pauli{ "XXI" }, .5 });
+	REQUIRE(hamiltonian.operators[1] == std::pair{ Pauli{ "IZZ" }, -1.25 });
+	REQUIRE(hamiltonian.operators[2] == std::pair{ Pauli{ "YIY" }, 2e-3 });
+
+	REQUIRE(readHamiltonianFromJson(writeTemporaryFile("read_hamiltonians_tests.json", " { \n } ")).operators.empty());
+}
+
+TEST_CASE("readHamiltonianFromJson single-quoted keys") {
+	const auto hamiltonian = readHamiltonianFromJson(writeTemporaryFile("read_hamiltonians_tests.json", R"({'XX': 1, "ZZ": -2, '-YY': 3})"));
+	REQUIRE(hamiltonian.operators.size() == 3);
+	REQUIRE(hamiltonian.operators[0] == std::pair{ Pauli{ "XX" }, 1. });
+	REQUIRE(hamiltonian.operators[1] == std::pair{ Pauli{ "ZZ" }, -2. });
+	REQUIRE(hamiltonian.operators[2] == std::pair{ Pauli{ "-YY" }, 3. });
+}
+
+TEST_CASE("readHamiltonianFromJson phases") {
+	const auto filename = writeTemporaryFile("read_hamiltonians_tests.json", R"({"iXZ": 1, "-XZ": 2, "-iXZ": 3, "XZ": 4})");
+	const auto hamiltonian = readHamiltonianFromJson(filename);
+	REQUIRE(hamiltonian.operators.size() == 4);
+	REQUIRE(hamiltonian.operators[0].first.getPhase() == BinaryPhase{ 1 });
+	REQUIRE(hamiltonian.operators[1].first.getPhase() == BinaryPhase{ 2 });
+	REQUIRE(hamiltonian.operators[2].first.getPhase() == BinaryPhase{ 3 });
+	REQUIRE(hamiltonian.operators[3].first.getPhase() == BinaryPhase{ 0 });
+	REQUIRE(hamiltonian.operators[2].first == Pauli{ "-iXZ" });
+}
+
+TEST_CASE("readHamiltonianFromJson large file") {
+	// More than 1 MB so that the file is split into chunks (given enough hardware threads)
+	constexpr int numQubits = 12;
+	constexpr int numTerms = 60000;
+	std::string content = "{\n";
+	std::vector<std::string> pauliStrings;
+	for (int k = 0; k < numTerms; ++k) {
+		std::string pauliString;
+		for (int q = 0; q < numQubits; ++q) pauliString += "IXYZ"[(k >> (q % 8) * 2) % 4];
+		pauliStrings.push_back(pauliString);
+		content += std::format("  \"{}\": {}{}\n", pauliString, k, k + 1 == numTerms ? "" : ",");
+	}
+	content += "}\n";
+	REQUIRE(content.size() > (1 << 20));
+
+	const auto hamiltonian = readHamiltonianFromJson(writeTemporaryFile("read_hamiltonians_tests.json", content));
+	REQUIRE(hamiltonian.numQubits == numQubits);
+	REQUIRE(hamiltonian.operators.size() == numTerms);
+	for (int k = 0; k < numTerms; ++k) {
+		REQUIRE(hamiltonian.operators[k].first == Pauli{ pauliStrings[k] });
+		REQUIRE(hamiltonian.operators[k].second == k);
+	}
+
+	// A comma inside a key is not a chunk boundary, the key is reported as invalid with its position
+	const auto badLine = numTerms / 2;
+	auto badContent = content;
+	const auto badOffset = badContent.find(pauliStrings[badLine], badContent.find(std::format(": {},", badLine - 1)));
+	badContent[badOffset + 3] = ',';
+	REQUIRE(jsonErrorFor(badContent).starts_with(std::format("Invalid character ',' in Pauli string at line {}, column 7", badLine + 2)));
+}
+
+TEST_CASE("readHamiltonianFromJson errors") {
+	REQUIRE(jsonErrorFor("{\n  \"XX\": 1,\n  \"XQ\": 2\n}").starts_with("Invalid character 'Q' in Pauli string at line 3, column 5"));
+	REQUIRE(jsonErrorFor("{\"XX\": 1,}").starts_with("Expected a Pauli string in quotes at line 1, column 10"));
+	REQUIRE(jsonErrorFor("{\"XX\": 1 \"ZZ\": 2}").starts_with("Expected ',' or '}' at line 1, column 10"));
+	REQUIRE(jsonErrorFor("{\"XX\": 1,\n\"ZZZ\": 2}").starts_with("The Pauli ZZZ does not have the same number of qubits as the preceding Paulis at line 2, column 1"));
+	REQUIRE(jsonErrorFor("{\"XX\": abc}").starts_with("Invalid coefficient at line 1, column 8"));
+	REQUIRE(jsonErrorFor("{\"XX\": inf}").starts_with("Invalid coefficient at line 1, column 8"));
+	REQUIRE(jsonErrorFor("{\"XX\": nan}").starts_with("Invalid coefficient at line 1, column 8"));
+	REQUIRE(jsonErrorFor("{\"XX\": -inf}").starts_with("Invalid coefficient at line 1, column 8"));
+	REQUIRE(jsonErrorFor("{\"XX\": +1}").starts_with("Invalid coefficient at line 1, column 8"));
+	REQUIRE(jsonErrorFor("{'XX\": 1}").starts_with("Unterminated string"));
+	REQUIRE(jsonErrorFor("{\"XX: 1}").starts_with("Unterminated string"));
+	REQUIRE(jsonErrorFor("\"XX\": 1}").starts_with("Expected '{' at line 1, column 1"));
+	REQUIRE(jsonErrorFor("{\"XX\": 1").starts_with("Expected '}' at the end of the file"));
+	REQUIRE(jsonErrorFor("{\"\": 1}").starts_with("Empty Pauli string"));
+	REQUIRE(jsonErrorFor("{\"-i\": 1}").starts_with("Empty Pauli string"));
+}
+
+TEST_CASE("Binary hamiltonian round trip") {
+	const Hamiltonian hamiltonian{ { { Pauli{ "XYZ" }, .5 }, { Pauli{ "-ZZI" }, 1.5 }, { Pauli{ "IIY" }, -2. } }, 3 };
+	const auto filename = temporaryFilename("read_hamiltonians_tests.bin");
+	writeHamiltonianBinary(filename, hamiltonian);
+	REQUIRE(isBinaryHamiltonian(filename));
+
+	// The phase -1 of ZZI is folded into its coefficient
+	const auto read = readHamiltonian(filename);
+	REQUIRE(read.numQubits == 3);
+	REQUIRE(read.operators.size() == 3);
+	REQUIRE(read.operators[0] == std::pair{ Pauli{ "XYZ" }, .5 });
+	REQUIRE(read.operators[1] == std::pair{ Pauli{ "ZZI" }, -1.5 });
+	REQUIRE(read.operators[2] == std::pair{ Pauli{ "IIY" }, -2. });
+
+	const HamiltonianTable table{ filename };
+	REQUIRE(table.size() == 3);
+	REQUIRE(table.xWords[0] == Pauli{ "XYZ" }.getXString());
+	REQUIRE(table.zWords[2] == Pauli{ "IIY" }.getZString());
+
+	const Hamiltonian imaginary{ { { Pauli{ "iXX" }, 1. } }, 2 };
+	REQUIRE_THROWS_AS(writeHamiltonianBinary(filename, imaginary), std::runtime_error);
+}
+
+TEST_CASE("Binary hamiltonian with wrong size") {
+	using namespace BinaryHamiltonianFormat;
+	auto header = [](uint64_t numTerms) {
+		std::string data{ magic, sizeof(magic) };
+		const uint32_t numQubits = 2;
+		data.append(reinterpret_cast<const char*>(&numQubits), sizeof(numQubits));
+		data.append(reinterpret_cast<const char*>(&byteOrderMark), sizeof(byteOrderMark));
+		data.append(reinterpret_cast<const char*>(&numTerms), sizeof(numTerms));
+		return data;
+	};
+	// 24 * 2^62 wraps around to 0 in 64 bits
+	REQUIRE_THROWS_AS(HamiltonianTable{ writeTemporaryFile("read_hamiltonians_tests.bin", header(uint64_t{ 1 } << 62)) }, ReadHamiltonianError);
+	REQUIRE_THROWS_AS(HamiltonianTable{ writeTemporaryFile("read_hamiltonians_tests.bin", header(1) + std::string(16, '\0')) }, ReadHamiltonianError);
+	REQUIRE(HamiltonianTable{ writeTemporaryFile("read_hamiltonians_tests.bin", header(1) + std::string(24, '\0')) }.size() == 1);
+}
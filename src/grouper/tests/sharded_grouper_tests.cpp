@@ -0,0 +1,30 @@
+#include "catch2/catch_test_macros.hpp"
+
+#include "sharded_grouper.h"
+
+
+using namespace Q;
+
+
+#ifndef _WIN32
+
+TEST_CASE("applyPauliGrouperSharded matches a single process") {
+	const Hamiltonian hamiltonian{ { 
+		{ Pauli{ "XXI" }, 1. }, { Pauli{ "ZZI" }, .9 }, { Pauli{ "IXX" }, .8 }, { Pauli{ "IZZ" }, .7 }, { Pauli{ "XIX" }, .6 }, 
+		{ Pauli{ "YYI" }, .5 }, { Pauli{ "ZIZ" }, .4 }, { Pauli{ "IYY" }, .3 }, { Pauli{ "XYZ" }, .2 }, { Pauli{ "ZXY" }, .1 } }, 3 };
+	const auto graphs = generateSubgraphs(Graph<>::linear(3));
+	const GrouperOptions options{ .verbose = false };
+	const auto expected = applyPauliGrouper2Multithread2(hamiltonian, graphs, options);
+
+	// More processes than graphs leaves some shards empty
+	for (const int numProcesses : { 1, 3, 6 }) {
+		const auto grouping = applyPauliGrouperSharded(hamiltonian, graphs, numProcesses, options);
+		REQUIRE(grouping.size() == expected.size());
+		for (size_t i = 0; i < grouping.size(); ++i) {
+			REQUIRE(grouping[i].paulis == expected[i].paulis);
+			REQUIRE(grouping[i].graph == expected[i].graph);
+		}
+	}
+}
+
+#endif
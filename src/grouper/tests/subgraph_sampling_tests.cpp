@@ -0,0 +1,35 @@
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/catch_approx.hpp"
+
+#include "subgraph_sampling.h"
+#include <limits>
+#include <random>
+
+
+using namespace Q;
+
+
+TEST_CASE("getBoundedComponentSubgraphs") {
+	std::mt19937_64 rng{ 42 };
+	const auto graph = Graph<>::linear(6);
+	const auto family = generateBoundedComponentSubgraphs(graph, 3);
+
+	// A request for all graphs (as numGraphs = all) takes the whole family
+	REQUIRE(getBoundedComponentSubgraphs(graph, std::numeric_limits<int64_t>::max(), 1000, 3, ComponentShape::Any, rng) == family);
+	REQUIRE(getBoundedComponentSubgraphs(graph, static_cast<int64_t>(family.size()), 1000, 3, ComponentShape::Any, rng) == family);
+
+	// Smaller requests are sampled
+	const auto samples = getBoundedComponentSubgraphs(graph, static_cast<int64_t>(family.size()) - 1, 1000, 3, ComponentShape::Any, rng);
+	REQUIRE(samples.size() == family.size() - 1);
+	for (const auto& sample : samples) REQUIRE(std::ranges::find(family, sample) != family.end());
+}
+
+TEST_CASE("getRandomSubgraphs") {
+	std::mt19937_64 rng{ 42 };
+	const auto graph = Graph<>::linear(5);
+	// All 16 subgraphs of the path with 4 edges
+	REQUIRE(getRandomSubgraphs(graph, std::numeric_limits<int64_t>::max(), 1000, rng).size() == 16);
+	const auto samples = getRandomSubgraphs(graph, 10, 2, rng);
+	REQUIRE(samples.size() == 10);
+	for (const auto& sample : samples) REQUIRE(sample.edgeCount() <= 2);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <random>
+#include <string>
+
+namespace Q {
+
+	/// @brief Path of a new file in the temporary directory, f.e. "<temp>/tests_3f2a..._7.json" for "tests.json". 
+	///        Names are unique within a test run and between concurrent runs, the extension is kept. 
+	inline std::string temporaryFilename(const std::string& name) {
+		static const auto runId = std::random_device{}();
+		static std::atomic_size_t counter{};
+		const std::filesystem::path path{ name };
+		const auto unique = std::format("{}_{:08x}_{}{}", path.stem().string(), runId, counter++, path.extension().string());
+		return (std::filesystem::temp_directory_path() / unique).string();
+	}
+
+	/// @brief Write the content to a new temporary file (see temporaryFilename()) and return its path. 
+	inline std::string writeTemporaryFile(const std::string& name, const std::string& content) {
+		const auto filename = temporaryFilename(name);
+		std::ofstream{ filename, std::ios::binary } << content;
+		return filename;
+	}
+
+}
@@ -2,8 +2,10 @@
 #include "gurobi_c++.h"
 #include "graph.h"
 #include "binary_pauli.h"
+#include "pauli.h"
 #include "symbolic.h"
 
+#include <atomic>
 #include <cassert>
 #include <optional>
 #include <string_view>
@@ -280,6 +282,15 @@ namespace Q {
 
 		int numOperatorsPerSet{};
 
+		// State of findHTCircuitIncremental(): graph and Paulis of the last call and the parity rows currently
+		// in the model (incrementalRows[j][i] for Pauli j and qubit i, empty rows are not added). 
+		std::optional<Graph<>> incrementalGraph;
+		std::vector<Pauli> incrementalPaulis;
+		std::vector<std::vector<std::optional<GRBConstr>>> incrementalRows;
+		std::vector<BinaryCliffordGate> lastSolution;
+
+		size_t numSolves{};
+
 	public:
 
 
@@ -328,6 +339,7 @@ namespace Q {
 		/// @return         If successfull, a list of symplectic 2x2 matrices, corresponding to the 6 single-qubit Clifford gates
 		std::optional<std::vector<BinaryCliffordGate>> findHTCircuit(const Graph<>& graph, bool verbose = false) {
 			using std::cout;
+			dropIncrementalRows();
 			auto numQubits = graph.numVertices();
 			auto numEqs = numQubits * numOperatorsPerSet;
 			std::vector<std::vector<GRBVar>*> aVars = { &axxVars,&axzVars,&azxVars,&azzVars };
@@ -393,6 +405,7 @@ namespace Q {
 			const std::vector<Pauli>& paulis,
 			bool verbose = false
 		) {
+			dropIncrementalRows();
 			auto numQubits = graph.numVertices();
 			auto numPaulis = paulis.size();
 			auto numEqs = numQubits * numPaulis;
@@ -432,6 +445,7 @@ namespace Q {
 			const std::vector<int>& qubits,
 			bool verbose = false
 		) {
+			dropIncrementalRows();
 			auto numQubits = qubits.size();
 			auto numPaulis = paulis.size();
 			auto numEqs = numQubits * numPaulis;
@@ -460,9 +474,240 @@ namespace Q {
 		}
 
 
+		/// @brief Same as findHTCircuit(graph, paulis) but the parity rows are kept in the model between calls and 
+		///        only the rows that changed are patched: rows of Paulis that differ from the previous call (compared
+		///        position-wise) and rows of qubits whose neighbourhood in the graph changed. The previous solution
+		///        is passed to the solver as a start. 
+		/// 
+		///        This pays off when consecutive calls use graphs that differ by few edges (see sortByGrayCode()) 
+		///        and Paulis are only appended to or removed from the back of the list. 
+		std::optional<std::vector<BinaryCliffordGate>> findHTCircuitIncremental(
+			const Graph<>& graph,
+			const std::vector<Pauli>& paulis,
+			bool verbose = false
+		) {
+			auto numQubits = graph.numVertices();
+			auto numPaulis = paulis.size();
+			const auto& gamma = graph.getAdjacencyMatrix();
+			updateSize(numQubits, numPaulis);
+
+			auto addRow = [&](int i, size_t j) -> std::optional<GRBConstr> {
+				GRBLinExpr expr;
+				bool empty = true;
+				if (paulis[j].x(i)) { expr += azxVars[i]; empty = false; }
+				if (paulis[j].z(i)) { expr += azzVars[i]; empty = false; }
+				for (int k = 0; k < numQubits; ++k) {
+					if (gamma(i, k)) {
+						if (paulis[j].x(k)) { expr += axxVars[k]; empty = false; }
+						if (paulis[j].z(k)) { expr += axzVars[k]; empty = false; }
+					}
+				}
+				if (empty) return std::nullopt;
+				return model->addConstr(expr * 0.5 == dummyVars[j * numQubits + i]);
+			};
+			auto removeRow = [&](std::optional<GRBConstr>& row) {
+				if (row) model->remove(*row);
+				row.reset();
+			};
+
+			size_t numUnchangedPaulis{};
+			if (incrementalGraph && incrementalGraph->numVertices() == numQubits) {
+				while (numUnchangedPaulis < std::min(numPaulis, incrementalPaulis.size()) && paulis[numUnchangedPaulis] == incrementalPaulis[numUnchangedPaulis]) {
+					++numUnchangedPaulis;
+				}
+			}
+			for (size_t j = numUnchangedPaulis; j < incrementalRows.size(); ++j) {
+				for (auto& row : incrementalRows[j]) removeRow(row);
+			}
+			incrementalRows.resize(numUnchangedPaulis);
+
+			if (numUnchangedPaulis > 0) {
+				const auto& previousGamma = incrementalGraph->getAdjacencyMatrix();
+				for (int i = 0; i < numQubits; ++i) {
+					bool neighbourhoodChanged{};
+					for (int k = 0; k < numQubits; ++k) {
+						if (gamma(i, k) != previousGamma(i, k)) neighbourhoodChanged = true;
+					}
+					if (!neighbourhoodChanged) continue;
+					for (size_t j = 0; j < numUnchangedPaulis; ++j) {
+						removeRow(incrementalRows[j][i]);
+						incrementalRows[j][i] = addRow(i, j);
+					}
+				}
+			}
+			for (size_t j = numUnchangedPaulis; j < numPaulis; ++j) {
+				auto& rows = incrementalRows.emplace_back();
+				for (int i = 0; i < numQubits; ++i) rows.push_back(addRow(i, j));
+			}
+			incrementalGraph = graph;
+			incrementalPaulis = paulis;
+
+			if (lastSolution.size() == static_cast<size_t>(numQubits)) {
+				for (int i = 0; i < numQubits; ++i) {
+					axxVars[i].set(GRB_DoubleAttr_Start, lastSolution[i](0, 0).toInt());
+					axzVars[i].set(GRB_DoubleAttr_Start, lastSolution[i](0, 1).toInt());
+					azxVars[i].set(GRB_DoubleAttr_Start, lastSolution[i](1, 0).toInt());
+					azzVars[i].set(GRB_DoubleAttr_Start, lastSolution[i](1, 1).toInt());
+				}
+			}
+			auto result = optimize({}, verbose);
+			if (result) lastSolution = *result;
+			return result;
+		}
+
+
+		struct SubsetResult {
+			std::vector<size_t> selected;                        // Indices of the selected Paulis (always contains 0)
+			std::vector<BinaryCliffordGate> singleQubitLayer;
+			double objective{};
+			bool optimal{};                                      // False if the time limit was hit or the solve was cut off
+		};
+
+		/// @brief Find a subset of given Paulis with maximal total weight that can be diagonalized by a hardware
+		///        tailored circuit for the given graph state |Γ〉 in a single solve. Each Pauli gets a selection binary
+		///        that gates its parity rows via indicator constraints. The first Pauli is always selected.
+		///
+		///        Pairs of Paulis that do not commute locally on each connected component of the graph are excluded
+		///        from being selected together up front.
+		/// @param graph       Graph that describes the graph state |Γ〉
+		/// @param paulis      Candidate Paulis, the first one is forced to be part of the subset
+		/// @param weights     Objective weight for each Pauli (use 1 everywhere to maximize the number of Paulis)
+		/// @param timeLimit   Time limit in seconds for the solve. If it is hit, the best incumbent is returned
+		/// @param cutoff      Optional: the solve is aborted as soon as the objective bound drops below this value
+		///                    (f.e. the best collection found so far with other graphs)
+		/// @param verbose     If set to true, each new incumbent is printed to stdout
+		/// @return            Nothing if the first Pauli alone cannot be diagonalized or no solution was found in time
+		std::optional<SubsetResult> findMaximalHTMeasurableSubset(
+			const Graph<>& graph,
+			const std::vector<Pauli>& paulis,
+			const std::vector<double>& weights,
+			double timeLimit,
+			const std::atomic<double>* cutoff = nullptr,
+			bool verbose = false
+		) {
+			assert(paulis.size() == weights.size() && !paulis.empty());
+
+			// Reports incumbents and aborts the solve once the bound shows that the graph cannot beat the cutoff.
+			class IncumbentCallback : public GRBCallback {
+			public:
+				IncumbentCallback(const std::atomic<double>* cutoff, bool verbose) : cutoff(cutoff), verbose(verbose) {}
+				int numIncumbents{};
+			protected:
+				void callback() override {
+					if (where == GRB_CB_MIPSOL) {
+						++numIncumbents;
+						if (verbose) println("New incumbent with objective {}", getDoubleInfo(GRB_CB_MIPSOL_OBJ));
+					}
+					else if (where == GRB_CB_MIP && cutoff) {
+						if (getDoubleInfo(GRB_CB_MIP_OBJBND) < cutoff->load() - 1e-6) abort();
+					}
+				}
+			private:
+				const std::atomic<double>* cutoff;
+				bool verbose;
+			};
+
+			try {
+				const auto numQubits = graph.numVertices();
+				const auto numPaulis = paulis.size();
+				const auto& gamma = graph.getAdjacencyMatrix();
+
+				GRBModel subsetModel{ env };
+				subsetModel.set(GRB_DoubleParam_TimeLimit, timeLimit);
+
+				std::vector<GRBVar> xx, xz, zx, zz;
+				for (int i = 0; i < numQubits; ++i) {
+					xx.push_back(subsetModel.addVar(0, 1, 0, GRB_BINARY));
+					xz.push_back(subsetModel.addVar(0, 1, 0, GRB_BINARY));
+					zx.push_back(subsetModel.addVar(0, 1, 0, GRB_BINARY));
+					zz.push_back(subsetModel.addVar(0, 1, 0, GRB_BINARY));
+					subsetModel.addQConstr(xx[i] * zz[i] + xz[i] * zx[i] == 1);
+				}
+
+				std::vector<GRBVar> selection;
+				GRBLinExpr objective;
+				for (size_t j = 0; j < numPaulis; ++j) {
+					selection.push_back(subsetModel.addVar(j == 0 ? 1 : 0, 1, 0, GRB_BINARY));
+					objective += weights[j] * selection[j];
+				}
+				subsetModel.setObjective(objective, GRB_MAXIMIZE);
+
+				for (int i = 0; i < numQubits; ++i) {
+					for (size_t j = 0; j < numPaulis; ++j) {
+						GRBLinExpr expr;
+						int numTerms{};
+						if (paulis[j].x(i)) { expr += zx[i]; ++numTerms; }
+						if (paulis[j].z(i)) { expr += zz[i]; ++numTerms; }
+						for (int k = 0; k < numQubits; ++k) {
+							if (gamma(i, k)) {
+								if (paulis[j].x(k)) { expr += xx[k]; ++numTerms; }
+								if (paulis[j].z(k)) { expr += xz[k]; ++numTerms; }
+							}
+						}
+						if (numTerms == 0) continue;
+						auto dummy = subsetModel.addVar(0, numTerms, 0, GRB_INTEGER);
+						if (j == 0) subsetModel.addConstr(expr == 2 * dummy);
+						else subsetModel.addGenConstrIndicator(selection[j], 1, expr - 2 * dummy == 0);
+					}
+				}
+
+				std::vector<uint64_t> componentSupports;
+				for (const auto& component : graph.connectedComponents()) {
+					uint64_t support{};
+					for (auto vertex : component) support |= (1ULL << vertex);
+					componentSupports.push_back(support);
+				}
+				for (size_t j = 0; j < numPaulis; ++j) {
+					for (size_t k = j + 1; k < numPaulis; ++k) {
+						const bool compatible = std::ranges::all_of(componentSupports, [&](uint64_t support) {
+							return commutesLocally(paulis[j], paulis[k], support); });
+						if (compatible) continue;
+						if (j == 0) selection[k].set(GRB_DoubleAttr_UB, 0);
+						else subsetModel.addConstr(selection[j] + selection[k] <= 1);
+					}
+				}
+
+				IncumbentCallback callback{ cutoff, verbose };
+				subsetModel.setCallback(&callback);
+				++numSolves;
+				subsetModel.optimize();
+
+				const auto status = subsetModel.get(GRB_IntAttr_Status);
+				if (status == GRB_INFEASIBLE || subsetModel.get(GRB_IntAttr_SolCount) == 0) {
+					return std::nullopt;
+				}
+
+				SubsetResult result;
+				result.optimal = status == GRB_OPTIMAL;
+				result.objective = subsetModel.get(GRB_DoubleAttr_ObjVal);
+				for (size_t j = 0; j < numPaulis; ++j) {
+					if (selection[j].get(GRB_DoubleAttr_X) > 0.5) result.selected.push_back(j);
+				}
+				result.singleQubitLayer.resize(numQubits);
+				for (int i = 0; i < numQubits; ++i) {
+					result.singleQubitLayer[i] = { xx[i].get(GRB_DoubleAttr_X), xz[i].get(GRB_DoubleAttr_X), zx[i].get(GRB_DoubleAttr_X), zz[i].get(GRB_DoubleAttr_X) };
+				}
+				return result;
+			}
+			catch (const GRBException& e) {
+				std::cout << "Error code = " << e.getErrorCode() << '\n';
+				std::cout << e.getMessage() << '\n';
+			}
+			catch (...) {
+				std::cout << "Exception during optimization" << '\n';
+			}
+			return std::nullopt;
+		}
+
+
+		/// @brief Number of solver runs so far
+		size_t getNumSolves() const { return numSolves; }
+
+
 		std::optional<std::vector<BinaryCliffordGate>> optimize(const std::vector<GRBConstr>& constraints, bool verbose) {
 
 			try {
+				++numSolves;
 				model->optimize();
 				auto t2 = std::chrono::high_resolution_clock::now();
 				//println("Time A: {}, Time B {}", t1 - t0, t2 - t1);
@@ -495,6 +740,18 @@ namespace Q {
 
 	private:
 
+		/// @brief Remove all parity rows that were left in the model by findHTCircuitIncremental(). 
+		void dropIncrementalRows() {
+			for (auto& rows : incrementalRows) {
+				for (auto& row : rows) {
+					if (row) model->remove(*row);
+				}
+			}
+			incrementalRows.clear();
+			incrementalPaulis.clear();
+			incrementalGraph.reset();
+		}
+
 		int numQubits{};
 		void updateSize(int newNumQubits, int numPaulis) {
 			auto numEquations = newNumQubits * numPaulis;
@@ -535,5 +792,161 @@ namespace Q {
 
 
 
+	/// @brief Finder for hardware-tailored circuits where the graph is not fixed but chosen by the solver among all
+	///        subgraphs of a given connectivity graph. Each edge of the connectivity becomes a binary variable and the
+	///        bilinear terms Γ_ik·a_k are linearized with auxiliary binaries. Among all feasible graphs, one with the
+	///        fewest edges is chosen. 
+	/// 
+	///        Paulis are added one at a time. Adding a Pauli that renders the model infeasible has no effect. 
+	class VariableGraphHTCircuitFinder {
+		GRBEnv env{ true };
+		std::unique_ptr<GRBModel> model;
+
+		Graph<> connectivity;
+		std::vector<std::pair<int, int>> edges;
+		std::vector<GRBVar> edgeVars;
+		std::vector<GRBVar> axxVars, axzVars, azxVars, azzVars;
+		// productX[i * n + k] linearizes Γ_ik·axx_k and productZ[i * n + k] linearizes Γ_ik·axz_k (only for edges (i,k))
+		std::vector<std::optional<GRBVar>> productX, productZ;
+
+		// Parity rows and their dummy variables for each added Pauli
+		std::vector<std::vector<GRBConstr>> pauliConstraints;
+		std::vector<std::vector<GRBVar>> pauliDummyVars;
+
+		Graph<> graph;
+		std::vector<BinaryCliffordGate> singleQubitLayer;
+
+	public:
+		/// @param connectivity  Hardware connectivity, the graph is chosen among its subgraphs
+		/// @param maxEdgeCount  Maximum number of edges for the chosen graph
+		/// @param numThreads    Number of threads for the solver (0: let the solver decide)
+		/// @param verbose       If set to true, the solver output is printed to stdout
+		VariableGraphHTCircuitFinder(const Graph<>& connectivity, int maxEdgeCount = std::numeric_limits<int>::max(), int numThreads = 0, bool verbose = false)
+			: connectivity(connectivity), edges(connectivity.getEdges()), graph(connectivity.numVertices()) {
+			env.set(GRB_IntParam_OutputFlag, verbose);
+			env.set("LogFile", "mip1.log");
+			env.start();
+
+			model = std::make_unique<GRBModel>(env);
+			model->set(GRB_IntParam_Threads, numThreads);
+
+			const auto n = connectivity.numVertices();
+			for (int i = 0; i < n; ++i) {
+				axxVars.push_back(model->addVar(0, 1, 0, GRB_BINARY, "axx" + std::to_string(i)));
+				axzVars.push_back(model->addVar(0, 1, 0, GRB_BINARY, "axz" + std::to_string(i)));
+				azxVars.push_back(model->addVar(0, 1, 0, GRB_BINARY, "azx" + std::to_string(i)));
+				azzVars.push_back(model->addVar(0, 1, 0, GRB_BINARY, "azz" + std::to_string(i)));
+				model->addQConstr(axxVars[i] * azzVars[i] + axzVars[i] * azxVars[i] == 1, "qc" + std::to_string(i));
+			}
+
+			// Linearize y = e·a via y <= e, y <= a, y >= e + a - 1
+			auto addProduct = [this](GRBVar e, GRBVar a) {
+				auto y = model->addVar(0, 1, 0, GRB_BINARY);
+				model->addConstr(y <= e);
+				model->addConstr(y <= a);
+				model->addConstr(y >= e + a - 1);
+				return y;
+			};
+
+			productX.resize(n * n);
+			productZ.resize(n * n);
+			GRBLinExpr edgeCount;
+			for (const auto& [i, k] : edges) {
+				auto e = model->addVar(0, 1, 1, GRB_BINARY, std::format("e{}_{}", i, k));
+				edgeVars.push_back(e);
+				edgeCount += e;
+				productX[i * n + k] = addProduct(e, axxVars[k]);
+				productZ[i * n + k] = addProduct(e, axzVars[k]);
+				productX[k * n + i] = addProduct(e, axxVars[i]);
+				productZ[k * n + i] = addProduct(e, axzVars[i]);
+			}
+			if (maxEdgeCount < static_cast<int>(edges.size())) {
+				model->addConstr(edgeCount <= maxEdgeCount, "maxEdgeCount");
+			}
+			model->setObjective(edgeCount, GRB_MINIMIZE);
+		}
+
+		VariableGraphHTCircuitFinder(const VariableGraphHTCircuitFinder&) = delete;
+		VariableGraphHTCircuitFinder& operator=(const VariableGraphHTCircuitFinder&) = delete;
+		VariableGraphHTCircuitFinder(VariableGraphHTCircuitFinder&&) = default;
+		VariableGraphHTCircuitFinder& operator=(VariableGraphHTCircuitFinder&&) = default;
+
+		/// @brief Add a Pauli to the set to diagonalize if there is a subgraph for which the set including the new 
+		///        Pauli can be diagonalized.
+		/// @return success
+		bool tryAddPauli(const Pauli& pauli) {
+			const auto n = connectivity.numVertices();
+			std::vector<GRBConstr> constraints;
+			std::vector<GRBVar> dummyVars;
+
+			for (int i = 0; i < n; ++i) {
+				GRBLinExpr expr;
+				int numTerms{};
+				if (pauli.x(i)) { expr += azxVars[i]; ++numTerms; }
+				if (pauli.z(i)) { expr += azzVars[i]; ++numTerms; }
+				for (int k = 0; k < n; ++k) {
+					if (!productX[i * n + k]) continue;
+					if (pauli.x(k)) { expr += *productX[i * n + k]; ++numTerms; }
+					if (pauli.z(k)) { expr += *productZ[i * n + k]; ++numTerms; }
+				}
+				if (numTerms == 0) continue;
+				dummyVars.push_back(model->addVar(0, numTerms, 0, GRB_INTEGER));
+				constraints.push_back(model->addConstr(expr == 2 * dummyVars.back()));
+			}
+
+			try {
+				model->optimize();
+				if (model->get(GRB_IntAttr_Status) == GRB_OPTIMAL) {
+					pauliConstraints.push_back(std::move(constraints));
+					pauliDummyVars.push_back(std::move(dummyVars));
+					readSolution();
+					return true;
+				}
+			}
+			catch (const GRBException& e) {
+				std::cout << "Error code = " << e.getErrorCode() << '\n';
+				std::cout << e.getMessage() << '\n';
+			}
+			for (auto& constr : constraints) model->remove(constr);
+			for (auto& var : dummyVars) model->remove(var);
+			return false;
+		}
+
+		/// @brief Remove all Paulis. 
+		void clear() {
+			for (auto& constraints : pauliConstraints) for (auto& constr : constraints) model->remove(constr);
+			for (auto& dummyVars : pauliDummyVars) for (auto& var : dummyVars) model->remove(var);
+			pauliConstraints.clear();
+			pauliDummyVars.clear();
+			graph = Graph<>(connectivity.numVertices());
+			singleQubitLayer.clear();
+		}
+
+		/// @brief Number of Paulis that have been added successfully since the last call to clear(). 
+		size_t numPaulis() const { return pauliConstraints.size(); }
+
+		/// @brief Graph found in the last successful call to tryAddPauli(). 
+		const Graph<>& getGraph() const { return graph; }
+
+		/// @brief Single-qubit layer found in the last successful call to tryAddPauli(). 
+		const std::vector<BinaryCliffordGate>& getSingleQubitLayer() const { return singleQubitLayer; }
+
+	private:
+
+		void readSolution() {
+			const auto n = connectivity.numVertices();
+			graph = Graph<>(n);
+			for (size_t i = 0; i < edges.size(); ++i) {
+				if (edgeVars[i].get(GRB_DoubleAttr_X) > 0.5) graph.addEdge(edges[i].first, edges[i].second);
+			}
+			singleQubitLayer.resize(n);
+			for (int i = 0; i < n; ++i) {
+				singleQubitLayer[i] = { axxVars[i].get(GRB_DoubleAttr_X) ,axzVars[i].get(GRB_DoubleAttr_X) ,azxVars[i].get(GRB_DoubleAttr_X) ,azzVars[i].get(GRB_DoubleAttr_X) };
+			}
+		}
+	};
+
+
+
 }
 
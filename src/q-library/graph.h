@@ -2,6 +2,7 @@
 #pragma once
 #include "efficient_binary_math.h"
 #include <iostream>
+#include <stdexcept>
 
 namespace Q {
 
@@ -463,6 +464,158 @@ namespace Q {
 	}
 
 
+	/// @brief Position of a bitstring in the binary reflected Gray code sequence, i.e. the inverse Gray code.
+	///        Consecutive positions correspond to bitstrings that differ in exactly one bit.
+	constexpr uint64_t grayCodeRank(uint64_t code) {
+		for (uint64_t shift = 1; shift < 64; shift <<= 1) {
+			code ^= code >> shift;
+		}
+		return code;
+	}
+
+	/// @brief Encode the edges of a subgraph as a bitmask over the given edge list (bit j is set if edges[j] is an edge of the subgraph).
+	template<size_t n>
+	constexpr uint64_t edgeMask(const Graph<n>& subgraph, const std::vector<std::pair<int, int>>& edges) {
+		if (edges.size() > 64) throw std::invalid_argument("Edge masks are only supported for up to 64 edges");
+		uint64_t mask{};
+		for (size_t j = 0; j < edges.size(); ++j) {
+			if (subgraph.hasEdge(edges[j].first, edges[j].second)) mask |= (1ULL << j);
+		}
+		return mask;
+	}
+
+	/// @brief Sort subgraphs of [graph] along the Gray code walk over their edge masks. For the full set of subgraphs
+	///        this yields a sequence where consecutive graphs differ by a single edge; for a sampled set it keeps
+	///        consecutive graphs close.
+	template<size_t n>
+	void sortByGrayCode(std::vector<Graph<n>>& subgraphs, const Graph<n>& graph) {
+		const auto edges = graph.getEdges();
+		std::vector<std::pair<uint64_t, size_t>> ranks;
+		for (size_t i = 0; i < subgraphs.size(); ++i) {
+			ranks.emplace_back(grayCodeRank(edgeMask(subgraphs[i], edges)), i);
+		}
+		std::ranges::sort(ranks);
+		std::vector<Graph<n>> sorted;
+		sorted.reserve(subgraphs.size());
+		for (const auto& [_, index] : ranks) sorted.push_back(std::move(subgraphs[index]));
+		subgraphs = std::move(sorted);
+	}
+
+
+	/// @brief Shape restriction for the connected components of a subgraph
+	enum class ComponentShape {
+		Any,   // Any connected graph
+		Path,  // Paths (no cycles, all degrees at most 2)
+		Star   // Stars (no cycles, at most one vertex with degree greater than 1)
+	};
+
+	/// @brief Check if the connected component of [subgraph] that contains [vertex] has at most [maxComponentSize]
+	///        vertices and the given shape.
+	template<size_t n>
+	bool isAdmissibleComponent(const Graph<n>& subgraph, int vertex, int maxComponentSize, ComponentShape shape) {
+		std::vector<int> component{ vertex };
+		std::vector<bool> visited(subgraph.numVertices());
+		visited[vertex] = true;
+		int degreeSum{};
+		int maxDegree{};
+		int numInnerVertices{};
+		for (size_t i = 0; i < component.size(); ++i) {
+			int degree{};
+			for (int w = 0; w < subgraph.numVertices(); ++w) {
+				if (!subgraph.hasEdge(component[i], w)) continue;
+				++degree;
+				if (visited[w]) continue;
+				if (static_cast<int>(component.size()) == maxComponentSize) return false;
+				visited[w] = true;
+				component.push_back(w);
+			}
+			degreeSum += degree;
+			maxDegree = std::max(maxDegree, degree);
+			numInnerVertices += degree > 1;
+		}
+		const bool isTree = degreeSum / 2 == static_cast<int>(component.size()) - 1;
+		switch (shape) {
+		case ComponentShape::Path: return isTree && maxDegree <= 2;
+		case ComponentShape::Star: return isTree && numInnerVertices <= 1;
+		default: return true;
+		}
+	}
+
+	/// @brief Visit the subgraphs of [graph] with at most [maxEdges] edges whose connected components have at most
+	///        [maxComponentSize] vertices and the given shape. The subgraphs are built edge by edge from the edge list
+	///        of [graph] and branches that violate the restrictions are cut immediately, so the number of steps is
+	///        proportional to the size of the family rather than to the number of all subgraphs.
+	///        The edgeless graph comes first. Enumeration stops after [maxCount] subgraphs.
+	template<size_t n, class Visitor>
+	void visitBoundedComponentSubgraphs(const Graph<n>& graph, int maxComponentSize, int maxEdges, ComponentShape shape, size_t maxCount, Visitor&& visit) {
+		const auto edges = graph.getEdges();
+		Graph<n> subgraph(graph.graphSize);
+		size_t count{};
+
+		// Each edge is either left out or added. The restrictions are inherited by subgraphs, so cutting a branch as
+		// soon as an added edge violates them does not lose any member of the family.
+		auto recurse = [&](auto&& self, size_t edgeIndex, int edgeCount) -> void {
+			if (count == maxCount) return;
+			if (edgeIndex == edges.size()) {
+				++count;
+				visit(subgraph);
+				return;
+			}
+			self(self, edgeIndex + 1, edgeCount);
+			if (edgeCount == maxEdges) return;
+			const auto [u, v] = edges[edgeIndex];
+			subgraph.addEdge(u, v);
+			if (isAdmissibleComponent(subgraph, u, maxComponentSize, shape)) self(self, edgeIndex + 1, edgeCount + 1);
+			subgraph.removeEdge(u, v);
+		};
+		recurse(recurse, 0, 0);
+	}
+
+	/// @brief Generate the family of visitBoundedComponentSubgraphs() (at most [maxCount] subgraphs).
+	template<size_t n>
+	std::vector<Graph<n>> generateBoundedComponentSubgraphs(const Graph<n>& graph, int maxComponentSize, int maxEdges = std::numeric_limits<int>::max(),
+		ComponentShape shape = ComponentShape::Any, size_t maxCount = std::numeric_limits<size_t>::max()) {
+
+		std::vector<Graph<n>> subgraphs;
+		visitBoundedComponentSubgraphs(graph, maxComponentSize, maxEdges, shape, maxCount, [&](const Graph<n>& subgraph) { subgraphs.push_back(subgraph); });
+		return subgraphs;
+	}
+
+	/// @brief Count the family of visitBoundedComponentSubgraphs() up to [maxCount] without storing it.
+	template<size_t n>
+	size_t countBoundedComponentSubgraphs(const Graph<n>& graph, int maxComponentSize, int maxEdges = std::numeric_limits<int>::max(),
+		ComponentShape shape = ComponentShape::Any, size_t maxCount = std::numeric_limits<size_t>::max()) {
+
+		size_t count{};
+		visitBoundedComponentSubgraphs(graph, maxComponentSize, maxEdges, shape, maxCount, [&](const Graph<n>&) { ++count; });
+		return count;
+	}
+
+	/// @brief Sample [num] subgraphs from the family of generateBoundedComponentSubgraphs(). Each sample visits the
+	///        edges of [graph] in random order and adds each edge with probability 1/2 if the restrictions stay
+	///        satisfied, so no sample is rejected. Every member of the family can be drawn but the distribution is
+	///        not uniform and duplicates are possible.
+	template<size_t n, class RNG>
+	std::vector<Graph<n>> sampleBoundedComponentSubgraphs(const Graph<n>& graph, size_t num, int maxComponentSize, int maxEdges, ComponentShape shape, RNG&& rng) {
+		auto edges = graph.getEdges();
+		std::vector<Graph<n>> subgraphs;
+		for (size_t i = 0; i < num; ++i) {
+			std::shuffle(edges.begin(), edges.end(), rng);
+			Graph<n> subgraph(graph.graphSize);
+			int edgeCount{};
+			for (const auto& [u, v] : edges) {
+				if (edgeCount == maxEdges) break;
+				if (rng() & 1) continue;
+				subgraph.addEdge(u, v);
+				if (isAdmissibleComponent(subgraph, u, maxComponentSize, shape)) ++edgeCount;
+				else subgraph.removeEdge(u, v);
+			}
+			subgraphs.push_back(subgraph);
+		}
+		return subgraphs;
+	}
+
+
 	namespace efficient {
 
 		// Space- (and often time-) efficient representation using bitstrings
@@ -29,6 +29,9 @@ namespace Q {
 
 		static constexpr Pauli Identity(int n);
 
+		/// @brief Create a Pauli operator from its X and Z components, e.g. (3, 0b011, 0b110) -> XYZ
+		static constexpr Pauli FromBitstrings(int n, Bitstring x, Bitstring z);
+
 
 
 		constexpr int numQubits() const { return n; };
@@ -136,6 +139,14 @@ namespace Q {
 		return Pauli{ n };
 	}
 
+	constexpr Pauli Pauli::FromBitstrings(int n, Bitstring x, Bitstring z) {
+		Pauli pauli{ n };
+		pauli.r = x;
+		pauli.s = z;
+		pauli.phase += pauli.getYPhase();
+		return pauli;
+	}
+
 
 	constexpr uint64_t Pauli::x(int qubit) const { return (r >> qubit) & 1ULL; }
 
@@ -3,6 +3,7 @@
 
 #include "graph.h"
 #include "formatting.h"
+#include <random>
 
 
 using namespace Q;
@@ -57,4 +58,58 @@ TEST_CASE("Connected components") {
 
 	graph = Graph<>::star(8);
 	REQUIRE(graph.connectedComponents(true) == std::vector<std::vector<int>>{ { {0, 1, 2, 3, 4, 5, 6, 7}}});
-}
\ No newline at end of file
+}
+
+TEST_CASE("Gray code ordering") {
+	REQUIRE(grayCodeRank(0b000) == 0);
+	REQUIRE(grayCodeRank(0b001) == 1);
+	REQUIRE(grayCodeRank(0b011) == 2);
+	REQUIRE(grayCodeRank(0b010) == 3);
+	REQUIRE(grayCodeRank(0b110) == 4);
+	REQUIRE(grayCodeRank(0b100) == 7);
+
+	const auto graph = Graph<>::linear(5);
+	auto subgraphs = generateSubgraphs(graph, 0, 4);
+	sortByGrayCode(subgraphs, graph);
+	REQUIRE(subgraphs.size() == 16);
+	REQUIRE(subgraphs.front().edgeCount() == 0);
+	const auto edges = graph.getEdges();
+	for (size_t i = 1; i < subgraphs.size(); ++i) {
+		REQUIRE(std::popcount(edgeMask(subgraphs[i], edges) ^ edgeMask(subgraphs[i - 1], edges)) == 1);
+	}
+
+	// 66 edges do not fit into a mask
+	Graph<> complete{ 12 };
+	for (int i = 0; i < 12; ++i) {
+		for (int j = i + 1; j < 12; ++j) complete.addEdge(i, j);
+	}
+	std::vector<Graph<>> completeSubgraphs{ complete };
+	REQUIRE_THROWS_AS(sortByGrayCode(completeSubgraphs, complete), std::invalid_argument);
+}
+
+TEST_CASE("Bounded component subgraphs") {
+	const auto graph = Graph<>::linear(4);
+	// Matchings of the path 0-1-2-3
+	REQUIRE(generateBoundedComponentSubgraphs(graph, 2).size() == 5);
+	// All subgraphs except the full path
+	REQUIRE(generateBoundedComponentSubgraphs(graph, 3).size() == 7);
+	REQUIRE(generateBoundedComponentSubgraphs(graph, 3, 1).size() == 4);
+	REQUIRE(generateBoundedComponentSubgraphs(graph, 4, 3, ComponentShape::Path).size() == 8);
+	REQUIRE(generateBoundedComponentSubgraphs(graph, 4, 3, ComponentShape::Path, 3).size() == 3);
+	REQUIRE(countBoundedComponentSubgraphs(graph, 3) == 7);
+	REQUIRE(countBoundedComponentSubgraphs(graph, 3, 1) == 4);
+	REQUIRE(countBoundedComponentSubgraphs(graph, 4, 3, ComponentShape::Path, 3) == 3);
+
+	const auto cycle = Graph<>::cycle(4);
+	// Subgraphs of the 4-cycle without the cycle itself and without the 4 paths of length 3
+	REQUIRE(generateBoundedComponentSubgraphs(cycle, 4, 4, ComponentShape::Star).size() == 16 - 1 - 4);
+	REQUIRE(generateBoundedComponentSubgraphs(cycle, 4, 4, ComponentShape::Path).size() == 16 - 1);
+
+	std::mt19937_64 rng{ 42 };
+	const auto samples = sampleBoundedComponentSubgraphs(Graph<>::linear(8), 100, 3, 4, ComponentShape::Any, rng);
+	REQUIRE(samples.size() == 100);
+	for (const auto& sample : samples) {
+		REQUIRE(sample.edgeCount() <= 4);
+		for (const auto& component : sample.connectedComponents()) REQUIRE(component.size() <= 3);
+	}
+}
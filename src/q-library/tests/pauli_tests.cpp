@@ -16,4 +16,10 @@ TEST_CASE("commutesLocally") {
 	REQUIRE(commutesLocally(Pauli{ "XX" }, Pauli{ "YZ" }, 0b01) == false);
 
 	REQUIRE(commutesLocally(Pauli{ "XZXXIIX" }, Pauli{ "YIZZXYZ" }, 0b1000111) == false);
-}
\ No newline at end of file
+}
+TEST_CASE("FromBitstrings") {
+	REQUIRE(Pauli::FromBitstrings(3, 0b011, 0b110) == Pauli{ "XYZ" });
+	REQUIRE(Pauli::FromBitstrings(2, 0b00, 0b00) == Pauli{ "II" });
+	REQUIRE(Pauli::FromBitstrings(4, 0b1010, 0b1010) == Pauli{ "IYIY" });
+	REQUIRE(Pauli::FromBitstrings(4, 0b1010, 0b1010).getPhase() == Pauli{ "IYIY" }.getPhase());
+}